@@ -0,0 +1,511 @@
+/********************************************************************************
+ *
+ *  This file is part of Urban3D
+ *  Copyright(C) 2025: Daniela Cabiddu
+ *
+ *  Author(s):
+ *
+ *  Tommaso Sorgente [tommaso.sorgente@cnr.it]
+ *  Daniela Cabiddu [daniela.cabiddu@cnr.it]
+ *
+ ********************************************************************************/
+
+// Benchmarks for the partitioning pipeline on synthetic workloads.
+//
+//   pip_bench [--benchmark_filter=<regex>] --benchmark_out=results.json --benchmark_out_format=json
+//
+// runs the suite and stores the results (items_per_second = points or features per second)
+// in a JSON file that can be tracked over time.
+//
+//   pip_bench generate -o <folder> [-n polygons] [-v vertices] [-H holes] [-N points] [-d uniform|clustered|scanline]
+//
+// writes a synthetic footprint layer (footprints.shp) and point cloud (points.las) to <folder>.
+
+#include "bench/synthetic.h"
+#include "meshing/auxiliary.h"
+#include "partitioning/pip_partition.h"
+
+#ifdef PIP_WITH_GDAL
+#include "io/gis_data.h"
+#include "io/write_GIS.h"
+#endif
+
+#include <benchmark/benchmark.h>
+#include <tclap/CmdLine.h>
+#include <liblas/liblas.hpp>
+#include <omp.h>
+
+#include <filesystem>
+#include <map>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+class Workload
+{
+public:
+    GISGeometryBuffer  layer;
+    std::vector<SHPObject*>     regions;
+    std::vector<cinolib::vec3d> points;
+
+    // the same regions and points, as consumed by the library classifier
+    URBAN3D::PolygonSet polys;
+    std::vector<double> xs, ys;
+};
+
+// workloads are generated once per parameter set and shared by all the benchmarks using them
+static const Workload & get_workload (const uint n_polygons, const uint n_vertices, const uint n_holes,
+                                      const URBAN3D::PointDistribution distribution, const size_t n_points)
+{
+    static std::map<std::tuple<uint,uint,uint,int,size_t>, Workload> cache;
+
+    auto key = std::make_tuple(n_polygons, n_vertices, n_holes, int(distribution), n_points);
+    auto it  = cache.find(key);
+
+    if (it != cache.end())
+        return it->second;
+
+    URBAN3D::SyntheticLayerParams params;
+    params.n_polygons = n_polygons;
+    params.n_vertices = n_vertices;
+    params.n_holes    = n_holes;
+
+    Workload &w = cache[key];
+    w.layer   = URBAN3D::make_footprints(params);
+    w.regions = URBAN3D::make_shp_objects(w.layer);
+    w.points  = URBAN3D::make_points(w.layer, n_points, distribution);
+
+    URBAN3D::load_polygons(w.layer, w.polys);
+
+    for (const cinolib::vec3d &p : w.points)
+    {
+        w.xs.push_back(p.x());
+        w.ys.push_back(p.y());
+    }
+
+    return w;
+}
+
+static fs::path bench_folder ()
+{
+    fs::path folder = fs::temp_directory_path() / "pip_bench";
+    fs::create_directories(folder);
+    return folder;
+}
+
+static void set_rate (benchmark::State &state, const size_t items_per_iteration)
+{
+    state.SetItemsProcessed(int64_t(state.iterations()) * items_per_iteration);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Classification
+
+// baseline: linear scan of the shapes, first region (in id order) whose polygon contains the point
+static void classify_linear (const std::vector<SHPObject*> &regions, const std::vector<cinolib::vec3d> &points, std::vector<uint> &point2region)
+{
+    #pragma omp parallel for schedule(static,1)
+    for (int64_t j = 0; j < (int64_t) points.size(); j++)
+    {
+        point2region[j] = UINT_MAX;
+
+        for (uint pid=0; pid < regions.size(); pid++)
+            if (pnpoly(regions[pid], points[j].x(), points[j].y()))
+            {
+                point2region[j] = pid;
+                break;
+            }
+    }
+}
+
+// args: polygons, vertices, holes, distribution
+static void BM_ClassifyLinear (benchmark::State &state)
+{
+    const Workload &w = get_workload(state.range(0), state.range(1), state.range(2),
+                                     URBAN3D::PointDistribution(state.range(3)), 1 << 14);
+
+    std::vector<uint> point2region (w.points.size());
+
+    for (auto _ : state)
+    {
+        classify_linear(w.regions, w.points, point2region);
+        benchmark::DoNotOptimize(point2region.data());
+    }
+
+    set_rate(state, w.points.size());
+}
+
+static void BM_ClassifyGrid (benchmark::State &state)
+{
+    const Workload &w = get_workload(state.range(0), state.range(1), state.range(2),
+                                     URBAN3D::PointDistribution(state.range(3)), 1 << 20);
+
+    std::vector<uint> point2region (w.points.size());
+
+    for (auto _ : state)
+    {
+        URBAN3D::classify(w.polys, w.xs.data(), w.ys.data(), w.xs.size(), point2region.data());
+        benchmark::DoNotOptimize(point2region.data());
+    }
+
+    set_rate(state, w.points.size());
+}
+
+static void BM_ClassifyBatch (benchmark::State &state)
+{
+    const Workload &w = get_workload(state.range(0), state.range(1), state.range(2),
+                                     URBAN3D::PointDistribution(state.range(3)), 1 << 20);
+
+    std::vector<uint> point2region (w.points.size());
+
+    for (auto _ : state)
+    {
+        URBAN3D::classify_batch(w.polys, w.xs.data(), w.ys.data(), nullptr, w.xs.size(), point2region.data());
+        benchmark::DoNotOptimize(point2region.data());
+    }
+
+    set_rate(state, w.points.size());
+}
+
+// polygon-driven strategy: compare with BM_ClassifyBatch as points per polygon grow
+static void BM_ClassifyByPolygon (benchmark::State &state)
+{
+    const Workload &w = get_workload(state.range(0), state.range(1), state.range(2),
+                                     URBAN3D::PointDistribution(state.range(3)), 1 << 20);
+
+    std::vector<uint> point2region (w.points.size());
+    std::vector<double> no_rank;
+
+    for (auto _ : state)
+    {
+        URBAN3D::classify_by_polygon(w.polys, no_rank, w.xs.data(), w.ys.data(), nullptr, w.xs.size(), point2region.data());
+        benchmark::DoNotOptimize(point2region.data());
+    }
+
+    set_rate(state, w.points.size());
+}
+
+// arg: number of threads
+static void BM_ClassifyThreads (benchmark::State &state)
+{
+    const Workload &w = get_workload(10000, 16, 0, URBAN3D::UNIFORM_POINTS, 1 << 20);
+
+    std::vector<uint> point2region (w.points.size());
+
+    int prev_threads = omp_get_max_threads();
+    omp_set_num_threads(state.range(0));
+
+    for (auto _ : state)
+    {
+        URBAN3D::classify(w.polys, w.xs.data(), w.ys.data(), w.xs.size(), point2region.data());
+        benchmark::DoNotOptimize(point2region.data());
+    }
+
+    omp_set_num_threads(prev_threads);
+
+    set_rate(state, w.points.size());
+}
+
+// points of the workload in the bbox of each polygon, in coordinates of type T
+template<class T>
+struct KernelInput
+{
+    std::vector<T> vx, vy;                     // polygon vertices
+    std::vector<std::vector<T>> px, py;        // polygon -> points in its bbox
+};
+
+template<class T>
+static void make_kernel_input (const Workload &w, KernelInput<T> &in)
+{
+    const URBAN3D::PolygonSet &polys = w.polys;
+
+    for (size_t i = 0; i < polys.num_vertices(); i++)
+    {
+        in.vx.push_back(T(polys.get_xs()[i]));
+        in.vy.push_back(T(polys.get_ys()[i]));
+    }
+
+    in.px.resize(polys.num_polygons());
+    in.py.resize(polys.num_polygons());
+
+    for (size_t j = 0; j < w.xs.size(); j++)
+        for (uint pid : polys.get_grid().candidates(w.xs[j], w.ys[j]))
+            if (polys.bbox(pid).contains(w.xs[j], w.ys[j]))
+            {
+                in.px[pid].push_back(T(w.xs[j]));
+                in.py[pid].push_back(T(w.ys[j]));
+            }
+}
+
+template<class T>
+static void run_kernel (const URBAN3D::PolygonSet &polys, const KernelInput<T> &in, std::vector<uint8_t> &inside)
+{
+    for (uint pid = 0; pid < polys.num_polygons(); pid++)
+    {
+        const URBAN3D::PolygonRings<T> p = polys.rings(pid, in.vx.data(), in.vy.data());
+        const size_t n = in.px[pid].size();
+
+        switch (polys.layout(pid))
+        {
+            case URBAN3D::SINGLE_RING: URBAN3D::pip_contains<T, URBAN3D::SINGLE_RING>(p, in.px[pid].data(), in.py[pid].data(), n, inside.data()); break;
+            case URBAN3D::WITH_HOLES:  URBAN3D::pip_contains<T, URBAN3D::WITH_HOLES>(p, in.px[pid].data(), in.py[pid].data(), n, inside.data()); break;
+            default:                   URBAN3D::pip_contains<T, URBAN3D::MULTIPART>(p, in.px[pid].data(), in.py[pid].data(), n, inside.data()); break;
+        }
+
+        benchmark::DoNotOptimize(inside.data());
+    }
+}
+
+// Crossing kernels alone, each polygon against the points in its bbox
+// args: coordinates (0: double, 1: PolygonSet batches (float with double fallback)), vertices, holes
+static void BM_CrossingKernel (benchmark::State &state)
+{
+    const Workload &w = get_workload(1000, state.range(1), state.range(2), URBAN3D::UNIFORM_POINTS, 1 << 20);
+
+    KernelInput<double> in_double;
+    make_kernel_input(w, in_double);
+
+    size_t n_tests = 0;
+    for (const auto &px : in_double.px)
+        n_tests += px.size();
+
+    std::vector<uint8_t> inside (w.xs.size());
+
+    for (auto _ : state)
+    {
+        if (state.range(0) == 0)
+            run_kernel(w.polys, in_double, inside);
+        else
+        {
+            for (uint pid = 0; pid < w.polys.num_polygons(); pid++)
+            {
+                w.polys.contains(pid, in_double.px[pid].data(), in_double.py[pid].data(), in_double.px[pid].size(), inside.data());
+                benchmark::DoNotOptimize(inside.data());
+            }
+        }
+    }
+
+    set_rate(state, n_tests);
+}
+
+BENCHMARK(BM_ClassifyLinear)
+    ->ArgNames({"polygons", "vertices", "holes", "distribution"})
+    ->ArgsProduct({{100, 1000}, {8, 64}, {0, 4}, {URBAN3D::UNIFORM_POINTS, URBAN3D::CLUSTERED_POINTS, URBAN3D::SCANLINE_POINTS}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_ClassifyGrid)
+    ->ArgNames({"polygons", "vertices", "holes", "distribution"})
+    ->ArgsProduct({{1000, 100000}, {8, 64}, {0, 4}, {URBAN3D::UNIFORM_POINTS, URBAN3D::CLUSTERED_POINTS, URBAN3D::SCANLINE_POINTS}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_ClassifyBatch)
+    ->ArgNames({"polygons", "vertices", "holes", "distribution"})
+    ->ArgsProduct({{1000, 100000}, {8, 64}, {0, 4}, {URBAN3D::UNIFORM_POINTS, URBAN3D::CLUSTERED_POINTS, URBAN3D::SCANLINE_POINTS}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_ClassifyByPolygon)
+    ->ArgNames({"polygons", "vertices", "holes", "distribution"})
+    ->ArgsProduct({{100, 1000, 100000}, {8, 64}, {0, 4}, {URBAN3D::UNIFORM_POINTS, URBAN3D::CLUSTERED_POINTS, URBAN3D::SCANLINE_POINTS}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_CrossingKernel)
+    ->ArgNames({"coords", "vertices", "holes"})
+    ->ArgsProduct({{0, 1}, {8, 64}, {0, 4}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_ClassifyThreads)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)->Range(1, std::max(1, omp_get_max_threads()))
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+////////////////////////////////////////////////////////////////////////////////
+// Read / write
+
+// arg: points
+static void BM_LasWrite (benchmark::State &state)
+{
+    const Workload &w = get_workload(1000, 16, 0, URBAN3D::UNIFORM_POINTS, state.range(0));
+    std::string filename = (bench_folder() / "write.las").string();
+
+    for (auto _ : state)
+        URBAN3D::write_las(filename, w.points);
+
+    set_rate(state, w.points.size());
+    state.SetBytesProcessed(int64_t(state.iterations()) * fs::file_size(filename));
+}
+
+static void BM_LasRead (benchmark::State &state)
+{
+    const Workload &w = get_workload(1000, 16, 0, URBAN3D::UNIFORM_POINTS, state.range(0));
+    std::string filename = (bench_folder() / "read.las").string();
+    URBAN3D::write_las(filename, w.points);
+
+    for (auto _ : state)
+    {
+        std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+        liblas::Reader reader(ifs);
+
+        std::vector<liblas::Point> points;
+        points.reserve(reader.GetHeader().GetPointRecordsCount());
+
+        while (reader.ReadNextPoint())
+            points.push_back(reader.GetPoint());
+
+        benchmark::DoNotOptimize(points.data());
+    }
+
+    set_rate(state, w.points.size());
+    state.SetBytesProcessed(int64_t(state.iterations()) * fs::file_size(filename));
+}
+
+// arg: polygons
+static void BM_ShapefileRead (benchmark::State &state)
+{
+    const Workload &w = get_workload(state.range(0), 16, 0, URBAN3D::UNIFORM_POINTS, 1);
+    std::string filename = (bench_folder() / "read.shp").string();
+    URBAN3D::write_shapefile(filename, w.layer);
+
+    for (auto _ : state)
+    {
+        int nRegions, nShapeType;
+        double adfBndsMin[4], adfBndsMax[4];
+
+        SHPHandle hSHP = SHPOpen(filename.c_str(), "rb");
+        SHPGetInfo(hSHP, &nRegions, &nShapeType, adfBndsMin, adfBndsMax);
+
+        for (int i = 0; i < nRegions; ++i)
+            SHPDestroyObject(SHPReadObject(hSHP, i));
+
+        SHPClose(hSHP);
+    }
+
+    set_rate(state, w.layer.num_features());
+}
+
+BENCHMARK(BM_LasWrite)->ArgName("points")->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LasRead)->ArgName("points")->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ShapefileRead)->ArgName("polygons")->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+#ifdef PIP_WITH_GDAL
+
+static const char * gis_extensions[] = {".shp", ".gpkg", ".fgb"};
+
+// args: polygons, format (0: Shapefile, 1: GeoPackage, 2: FlatGeobuf)
+static void BM_GisWrite (benchmark::State &state)
+{
+    const Workload &w = get_workload(state.range(0), 16, 0, URBAN3D::UNIFORM_POINTS, 1);
+
+    GISData gis_data;
+    for (size_t fid=0; fid < w.layer.num_features(); fid++)
+    {
+        GISSpan<const cinolib::vec3d> ring = w.layer.feature_first_ring(fid);
+        gis_data.add_polygon(std::vector<cinolib::vec3d>(ring.begin(), ring.end()));
+        gis_data.add_polygon_field({GISDataField{"id", "int", std::to_string(fid)}});
+    }
+    gis_data.set_epsg(32632);
+
+    std::string filename = (bench_folder() / (std::string("write") + gis_extensions[state.range(1)])).string();
+
+    for (auto _ : state)
+        URBAN3D::write_GIS(filename, gis_data);
+
+    set_rate(state, w.layer.num_features());
+}
+
+static void BM_GisRead (benchmark::State &state)
+{
+    const Workload &w = get_workload(state.range(0), 16, 0, URBAN3D::UNIFORM_POINTS, 1);
+
+    GISData gis_data;
+    for (size_t fid=0; fid < w.layer.num_features(); fid++)
+    {
+        GISSpan<const cinolib::vec3d> ring = w.layer.feature_first_ring(fid);
+        gis_data.add_polygon(std::vector<cinolib::vec3d>(ring.begin(), ring.end()));
+        gis_data.add_polygon_field({GISDataField{"id", "int", std::to_string(fid)}});
+    }
+    gis_data.set_epsg(32632);
+
+    std::string filename = (bench_folder() / (std::string("read") + gis_extensions[state.range(1)])).string();
+    URBAN3D::write_GIS(filename, gis_data);
+
+    for (auto _ : state)
+    {
+        GISData in;
+        GDALClose(in.read(filename, GDAL_OF_VECTOR));
+    }
+
+    set_rate(state, w.layer.num_features());
+}
+
+BENCHMARK(BM_GisWrite)->ArgNames({"polygons", "format"})->ArgsProduct({{1000, 100000}, {0, 1, 2}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_GisRead)->ArgNames({"polygons", "format"})->ArgsProduct({{1000, 100000}, {0, 1, 2}})->Unit(benchmark::kMillisecond);
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int generate (int argc, char *argv[])
+{
+    std::string out_folder;
+    URBAN3D::SyntheticLayerParams params;
+    size_t n_points;
+    std::string distribution;
+
+    try
+    {
+        TCLAP::CmdLine cmd("pip_bench generate", ' ', "version 0.5");
+
+        TCLAP::ValueArg<std::string> out_arg("o", "output-folder", "Output folder", true, "", "string", cmd);
+        TCLAP::ValueArg<uint> polys_arg("n", "polygons", "Number of polygons", false, 1000, "uint", cmd);
+        TCLAP::ValueArg<uint> verts_arg("v", "vertices", "Vertices per exterior ring", false, 16, "uint", cmd);
+        TCLAP::ValueArg<uint> holes_arg("H", "holes", "Holes per polygon", false, 0, "uint", cmd);
+        TCLAP::ValueArg<size_t> points_arg("N", "points", "Number of points", false, 1000000, "size_t", cmd);
+        TCLAP::ValueArg<std::string> dist_arg("d", "distribution", "Point distribution: uniform, clustered, scanline", false, "uniform", "string", cmd);
+
+        cmd.parse(argc, argv);
+
+        out_folder        = out_arg.getValue();
+        params.n_polygons = polys_arg.getValue();
+        params.n_vertices = verts_arg.getValue();
+        params.n_holes    = holes_arg.getValue();
+        n_points          = points_arg.getValue();
+        distribution      = dist_arg.getValue();
+    }
+    catch (TCLAP::ArgException &e) // catch exceptions
+    {
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return -3;
+    }
+
+    URBAN3D::PointDistribution d = URBAN3D::UNIFORM_POINTS;
+    if (distribution == "clustered")     d = URBAN3D::CLUSTERED_POINTS;
+    else if (distribution == "scanline") d = URBAN3D::SCANLINE_POINTS;
+
+    fs::create_directories(out_folder);
+
+    GISGeometryBuffer layer = URBAN3D::make_footprints(params);
+
+    if (!URBAN3D::write_shapefile(out_folder + "/footprints.shp", layer) ||
+        !URBAN3D::write_las(out_folder + "/points.las", URBAN3D::make_points(layer, n_points, d)))
+        return 1;
+
+    std::cout << "Written " << layer.num_features() << " polygons and " << n_points << " points to " << out_folder << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "generate")
+        return generate(argc-1, argv+1);
+
+    benchmark::Initialize(&argc, argv);
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,585 @@
+/********************************************************************************
+ *
+ *  This file is part of Urban3D
+ *  Copyright(C) 2025: Daniela Cabiddu
+ *
+ *  Author(s):
+ *
+ *  Tommaso Sorgente [tommaso.sorgente@cnr.it]
+ *  Daniela Cabiddu [daniela.cabiddu@cnr.it]
+ *
+ ********************************************************************************/
+
+// Differential check of the classifiers against the reference point-in-polygon test
+// (pnpoly() over all the rings of a feature, even-odd rule).
+//
+//   pip_verify [-t 1,2,4,8] [-n polygons] [-N points] [-s seed]
+//
+// builds an adversarial layer (see make_adversarial_footprints()) and points on its
+// vertices and edges, at the Y of its vertices and uniform over its extent, then runs
+// every classifier at each thread count and compares the regions found with those
+// of the reference. With GDAL (and GEOS), the random points are also compared with
+// OGR Contains (the boundary points are not: Contains excludes the boundary).
+// The mesh classifier (MeshLocator) is checked the same way on the grid of the cells
+// hosting the adversarial shapes (see make_adversarial_cells()), a tessellation with
+// the vertices shared by neighbour cells. Exits with 1 on any mismatch.
+
+#include "bench/synthetic.h"
+#include "meshing/auxiliary.h"
+#include "partitioning/pip_partition.h"
+
+#ifdef PIP_WITH_GDAL
+#include <ogr_geometry.h>
+#endif
+
+#include <tclap/CmdLine.h>
+#include <omp.h>
+
+#include <cstdio>
+#include <map>
+#include <random>
+#include <sstream>
+
+class Verifier
+{
+public:
+
+    GISGeometryBuffer   layer;
+    URBAN3D::PolygonSet polys, prism_polys;
+    URBAN3D::SegmentGrid edges;
+
+    std::vector<double> xs, ys, zs;
+    size_t n_random = 0;              // the last n_random points are not on the geometry
+
+    std::vector<URBAN3D::BBox2> bboxes;   // feature -> bbox
+    std::vector<std::vector<uint>> containing;   // point -> features containing it (reference)
+    std::vector<double> priorities;
+
+    double halo = 0.0, nearest = 0.0;
+
+    size_t n_checks = 0, n_failed = 0;
+
+    size_t num_points () const { return xs.size(); }
+
+    bool contains (const uint fid, const double x, const double y) const
+    {
+        return bboxes[fid].contains(x, y) && pnpoly(layer, fid, x, y);
+    }
+
+    // the points, then the features containing each of them
+    void set_points (const std::vector<cinolib::vec3d> &points, const size_t n_rand);
+    void build_reference ();
+
+    // compares got with expected (for the points first, first+1, ...), reporting the first mismatches
+    template<class T>
+    void check (const std::string &name, const int threads, const std::vector<T> &expected, const std::vector<T> &got,
+                const size_t first = 0);
+};
+
+void Verifier::set_points (const std::vector<cinolib::vec3d> &points, const size_t n_rand)
+{
+    for (const cinolib::vec3d &p : points)
+    {
+        xs.push_back(p.x());
+        ys.push_back(p.y());
+        zs.push_back(p.z());
+    }
+
+    n_random = n_rand;
+}
+
+void Verifier::build_reference ()
+{
+    bboxes.resize(layer.num_features());
+    for (size_t fid=0; fid < layer.num_features(); fid++)
+        for (const cinolib::vec3d &p : layer.feature_coords(fid))
+            bboxes[fid].add(p.x(), p.y());
+
+    containing.resize(num_points());
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int64_t j = 0; j < (int64_t) num_points(); j++)
+        for (uint fid=0; fid < layer.num_features(); fid++)
+            if (contains(fid, xs[j], ys[j]))
+                containing[j].push_back(fid);
+}
+
+static std::string to_string (const uint pid)
+{
+    return pid == UINT_MAX ? "none" : std::to_string(pid);
+}
+
+static std::string to_string (const std::vector<uint> &pids)
+{
+    std::stringstream ss;
+    ss << "{";
+    for (size_t i=0; i < pids.size(); i++)
+        ss << (i ? "," : "") << pids[i];
+    ss << "}";
+    return ss.str();
+}
+
+template<class T>
+void Verifier::check (const std::string &name, const int threads, const std::vector<T> &expected, const std::vector<T> &got,
+                      const size_t first)
+{
+    size_t n_bad = 0;
+
+    for (size_t j=0; j < expected.size(); j++)
+    {
+        if (expected[j] == got[j])
+            continue;
+
+        if (n_bad++ < 3)
+        {
+            char point[128];
+            snprintf(point, sizeof(point), "(%.17g, %.17g, %.17g)", xs[first+j], ys[first+j], zs[first+j]);
+            std::cout << "    point " << first+j << " " << point << ": expected " << to_string(expected[j])
+                      << ", got " << to_string(got[j]) << std::endl;
+        }
+    }
+
+    n_checks++;
+    if (n_bad > 0)
+        n_failed++;
+
+    printf("%-28s threads %3d: %s (%zu mismatches / %zu points)\n", name.c_str(), threads,
+           n_bad ? "FAILED" : "ok", n_bad, expected.size());
+}
+
+static std::vector<std::vector<uint>> to_lists (const URBAN3D::PointRegions &pr)
+{
+    std::vector<std::vector<uint>> lists (pr.num_points());
+
+    for (size_t j=0; j < lists.size(); j++)
+        lists[j].assign(pr.of(j).begin(), pr.of(j).end());
+
+    return lists;
+}
+
+// region of each point with the lowest key (ties: lowest id) among those passing keep
+template<class K, class F>
+static std::vector<uint> expected_best (const Verifier &v, const K &key, const F &keep)
+{
+    std::vector<uint> best (v.num_points(), UINT_MAX);
+
+    for (size_t j=0; j < v.num_points(); j++)
+        for (uint pid : v.containing[j])
+            if (keep(pid, j) && (best[j] == UINT_MAX || key(pid) < key(best[j])))
+                best[j] = pid;
+
+    return best;
+}
+
+static void verify_classifiers (Verifier &v, const int threads)
+{
+    using namespace URBAN3D;
+
+    const size_t n = v.num_points();
+    const double *x = v.xs.data(), *y = v.ys.data(), *z = v.zs.data();
+
+    auto any   = [](const uint, const size_t) { return true; };
+    auto by_id = [](const uint pid) { return double(pid); };
+
+    const std::vector<uint> first = expected_best(v, by_id, any);
+
+    std::vector<uint> p2r (n);
+    PointRegions pr;
+
+    // locate() and the scalar grid classifier
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int64_t j = 0; j < (int64_t) n; j++)
+        p2r[j] = v.polys.locate(x[j], y[j]);
+    v.check("locate", threads, first, p2r);
+
+    classify(v.polys, x, y, n, p2r.data());
+    v.check("classify", threads, first, p2r);
+
+    classify_batch(v.polys, x, y, nullptr, n, p2r.data());
+    v.check("classify_batch", threads, first, p2r);
+
+    // batched crossing kernels (float with double fallback), each polygon against the points in its bbox
+    {
+        std::vector<std::vector<uint>> in_bbox (v.polys.num_polygons());
+        std::vector<std::vector<uint8_t>> inside (v.polys.num_polygons());
+
+        for (size_t j=0; j < n; j++)
+            for (uint pid : v.polys.get_grid().candidates(x[j], y[j]))
+                if (v.polys.bbox(pid).contains(x[j], y[j]))
+                    in_bbox[pid].push_back(j);
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int64_t pid = 0; pid < (int64_t) v.polys.num_polygons(); pid++)
+        {
+            std::vector<double> px, py;
+
+            for (uint j : in_bbox[pid])
+            {
+                px.push_back(x[j]);
+                py.push_back(y[j]);
+            }
+
+            inside[pid].resize(px.size());
+            v.polys.contains(pid, px.data(), py.data(), px.size(), inside[pid].data());
+        }
+
+        // polygons are visited in id order: the lists are sorted
+        std::vector<std::vector<uint>> got (n);
+
+        for (uint pid=0; pid < v.polys.num_polygons(); pid++)
+            for (size_t k=0; k < in_bbox[pid].size(); k++)
+                if (inside[pid][k])
+                    got[in_bbox[pid][k]].push_back(pid);
+
+        v.check("PolygonSet::contains", threads, v.containing, got);
+    }
+
+    // overlap policies
+    std::vector<double> no_priorities;
+
+    classify(v.polys, FIRST_REGION, no_priorities, x, y, nullptr, n, p2r.data(), pr);
+    v.check("policy first", threads, first, p2r);
+
+    classify(v.polys, ALL_REGIONS, no_priorities, x, y, nullptr, n, p2r.data(), pr);
+    v.check("policy all", threads, v.containing, to_lists(pr));
+
+    assign_all(v.polys, x, y, nullptr, n, pr);
+    v.check("assign_all", threads, v.containing, to_lists(pr));
+
+    const std::vector<uint> smallest = expected_best(v, [&](const uint pid) { return std::make_pair(v.polys.area(pid), pid); }, any);
+
+    classify(v.polys, SMALLEST_AREA, no_priorities, x, y, nullptr, n, p2r.data(), pr);
+    v.check("policy smallest", threads, smallest, p2r);
+
+    classify_ranked(v.polys, v.polys.get_areas(), x, y, nullptr, n, p2r.data());
+    v.check("classify_ranked", threads, smallest, p2r);
+
+    // polygon-driven strategy
+    classify_by_polygon(v.polys, no_priorities, x, y, nullptr, n, p2r.data());
+    v.check("classify_by_polygon", threads, first, p2r);
+
+    classify_by_polygon(v.polys, v.polys.get_areas(), x, y, nullptr, n, p2r.data());
+    v.check("classify_by_polygon ranked", threads, smallest, p2r);
+
+    classify(v.polys, HIGHEST_PRIORITY, v.priorities, x, y, nullptr, n, p2r.data(), pr);
+    v.check("policy priority", threads, expected_best(v, [&](const uint pid) { return std::make_pair(-v.priorities[pid], pid); }, any), p2r);
+
+    // prisms: regions only hold the points within their Z range
+    auto in_z = [&](const uint pid, const size_t j) { return v.prism_polys.in_z_range(pid, z[j]); };
+
+    classify_batch(v.prism_polys, x, y, z, n, p2r.data());
+    v.check("prism classify_batch", threads, expected_best(v, by_id, in_z), p2r);
+
+    classify_by_polygon(v.prism_polys, no_priorities, x, y, z, n, p2r.data());
+    v.check("prism classify_by_polygon", threads, expected_best(v, by_id, in_z), p2r);
+
+    classify(v.prism_polys, SMALLEST_AREA, no_priorities, x, y, z, n, p2r.data(), pr);
+    v.check("prism policy smallest", threads, expected_best(v, [&](const uint pid) { return std::make_pair(v.polys.area(pid), pid); }, in_z), p2r);
+
+    assign_all(v.prism_polys, x, y, z, n, pr);
+    {
+        std::vector<std::vector<uint>> expected (n);
+        for (size_t j=0; j < n; j++)
+            for (uint pid : v.containing[j])
+                if (in_z(pid, j))
+                    expected[j].push_back(pid);
+
+        v.check("prism assign_all", threads, expected, to_lists(pr));
+    }
+
+    // halo: the regions containing the point and those with an edge within the halo distance
+    {
+        std::vector<std::vector<uint>> expected (n);
+
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (int64_t j = 0; j < (int64_t) n; j++)
+        {
+            for (uint pid=0; pid < v.polys.num_polygons(); pid++)
+            {
+                bool near = std::find(v.containing[j].begin(), v.containing[j].end(), pid) != v.containing[j].end();
+
+                const URBAN3D::BBox2 &b = v.polys.bbox(pid);
+                if (!near && x[j] >= b.xmin - v.halo && x[j] <= b.xmax + v.halo && y[j] >= b.ymin - v.halo && y[j] <= b.ymax + v.halo)
+                {
+                    uint64_t begin = v.polys.ring_vert_begin(v.polys.poly_ring_begin(pid));
+                    uint64_t end   = v.polys.ring_vert_begin(v.polys.poly_ring_end(pid));
+
+                    for (uint64_t e = begin; e < end && !near; e++)
+                        near = v.edges.edge_distance(e, x[j], y[j]) <= v.halo;
+                }
+
+                if (near)
+                    expected[j].push_back(pid);
+            }
+        }
+
+        classify_batch(v.polys, x, y, nullptr, n, p2r.data());
+        assign_halo(v.polys, v.edges, x, y, nullptr, n, p2r.data(), v.halo, pr);
+        v.check("assign_halo", threads, expected, to_lists(pr));
+    }
+
+    // nearest region fallback: the unassigned points go to the region with the nearest edge
+    {
+        std::vector<uint> expected = first;
+
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (int64_t j = 0; j < (int64_t) n; j++)
+        {
+            if (expected[j] != UINT_MAX)
+                continue;
+
+            double best_d = v.nearest;
+
+            for (uint pid=0; pid < v.polys.num_polygons(); pid++)
+            {
+                uint64_t begin = v.polys.ring_vert_begin(v.polys.poly_ring_begin(pid));
+                uint64_t end   = v.polys.ring_vert_begin(v.polys.poly_ring_end(pid));
+
+                for (uint64_t e = begin; e < end; e++)
+                {
+                    double d = v.edges.edge_distance(e, x[j], y[j]);
+
+                    if (d < best_d || (d == best_d && pid < expected[j]))
+                    {
+                        best_d = d;
+                        expected[j] = pid;
+                    }
+                }
+            }
+        }
+
+        classify_batch(v.polys, x, y, nullptr, n, p2r.data());
+        assign_nearest(v.edges, x, y, nullptr, n, v.nearest, p2r.data());
+        v.check("assign_nearest", threads, expected, p2r);
+    }
+}
+
+// Polygon mesh of the cells, merging the coincident corners so that neighbour
+// cells share their edges
+static cinolib::Polygonmesh<> to_mesh (const GISGeometryBuffer &cells)
+{
+    cinolib::Polygonmesh<> mesh;
+    std::map<std::pair<double,double>, uint> vert_ids;
+
+    for (size_t fid=0; fid < cells.num_features(); fid++)
+    {
+        GISSpan<const cinolib::vec3d> ring = cells.feature_first_ring(fid);
+
+        std::vector<uint> vids;
+
+        for (size_t k=0; k+1 < ring.size(); k++)
+        {
+            auto it = vert_ids.emplace(std::make_pair(ring[k].x(), ring[k].y()), 0);
+
+            if (it.second)
+                it.first->second = mesh.vert_add(ring[k]);
+
+            vids.push_back(it.first->second);
+        }
+
+        mesh.poly_add(vids);
+    }
+
+    return mesh;
+}
+
+// the mesh classifier, walking from the cell of the previous point or through the grid only.
+// The cells follow the crossing rule of the reference: a point on an edge shared by two
+// cells goes to the cell on its right, or above it for a horizontal edge
+static void verify_mesh (Verifier &m, const URBAN3D::MeshLocator &locator, const int threads)
+{
+    const size_t n = m.num_points();
+    const double *x = m.xs.data(), *y = m.ys.data();
+
+    const std::vector<uint> first = expected_best(m, [](const uint pid) { return double(pid); },
+                                                  [](const uint, const size_t) { return true; });
+
+    std::vector<uint> p2r (n);
+
+    URBAN3D::classify(locator, x, y, n, p2r.data());
+    m.check("MeshLocator classify", threads, first, p2r);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int64_t j = 0; j < (int64_t) n; j++)
+    {
+        int pid = locator.locate_indexed(x[j], y[j]);
+        p2r[j] = (pid >= 0) ? uint(pid) : UINT_MAX;
+    }
+    m.check("MeshLocator locate_indexed", threads, first, p2r);
+}
+
+#ifdef PIP_WITH_GDAL
+
+// the random points against OGR Contains
+static void verify_ogr (Verifier &v)
+{
+    if (!OGRGeometryFactory::haveGEOS())
+    {
+        std::cout << "OGR Contains: skipped (GDAL built without GEOS)" << std::endl;
+        return;
+    }
+
+    std::vector<OGRMultiPolygon> features (v.layer.num_features());
+
+    for (size_t fid=0; fid < v.layer.num_features(); fid++)
+    {
+        for (uint64_t part = v.layer.feature_part_begin(fid); part < v.layer.feature_part_end(fid); part++)
+        {
+            OGRPolygon polygon;
+
+            for (uint64_t r = v.layer.part_ring_begin(part); r < v.layer.part_ring_end(part); r++)
+            {
+                OGRLinearRing ring;
+                for (const cinolib::vec3d &p : v.layer.ring(r))
+                    ring.addPoint(p.x(), p.y());
+                polygon.addRing(&ring);
+            }
+
+            features[fid].addGeometry(&polygon);
+        }
+    }
+
+    const size_t begin = v.num_points() - v.n_random;
+
+    std::vector<std::vector<uint>> expected (v.n_random), got (v.n_random);
+
+    for (size_t j = begin; j < v.num_points(); j++)
+    {
+        expected[j - begin] = v.containing[j];
+
+        OGRPoint point (v.xs[j], v.ys[j]);
+
+        for (uint fid=0; fid < features.size(); fid++)
+            if (v.bboxes[fid].contains(v.xs[j], v.ys[j]) && features[fid].Contains(&point))
+                got[j - begin].push_back(fid);
+    }
+
+    v.check("OGR Contains", 1, expected, got, begin);
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+    std::string thread_list;
+    URBAN3D::SyntheticLayerParams params;
+    size_t n_random;
+
+    try
+    {
+        TCLAP::CmdLine cmd("pip_verify", ' ', "version 0.5");
+
+        TCLAP::ValueArg<std::string> threads_arg("t", "threads", "Comma-separated thread counts (default: 1, 2, 4 and the available cores)", false, "", "string", cmd);
+        TCLAP::ValueArg<uint> polys_arg("n", "polygons", "Number of polygons", false, 100, "uint", cmd);
+        TCLAP::ValueArg<size_t> points_arg("N", "points", "Number of random points, besides those on the geometry", false, 100000, "size_t", cmd);
+        TCLAP::ValueArg<uint> seed_arg("s", "seed", "Random seed", false, 42, "uint", cmd);
+
+        cmd.parse(argc, argv);
+
+        thread_list       = threads_arg.getValue();
+        params.n_polygons = polys_arg.getValue();
+        params.seed       = seed_arg.getValue();
+        n_random          = points_arg.getValue();
+    }
+    catch (TCLAP::ArgException &e) // catch exceptions
+    {
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return -3;
+    }
+
+    std::vector<int> thread_counts;
+
+    if (thread_list.empty())
+    {
+        for (int t : {1, 2, 4, omp_get_max_threads()})
+            if (std::find(thread_counts.begin(), thread_counts.end(), t) == thread_counts.end())
+                thread_counts.push_back(t);
+    }
+    else
+    {
+        std::stringstream ss (thread_list);
+        std::string item;
+
+        while (std::getline(ss, item, ','))
+        {
+            int t = std::atoi(item.c_str());
+
+            if (t < 1)
+            {
+                std::cerr << "Invalid thread count: " << item << std::endl;
+                return 1;
+            }
+
+            thread_counts.push_back(t);
+        }
+    }
+
+    Verifier v;
+
+    v.layer = URBAN3D::make_adversarial_footprints(params);
+    v.set_points(URBAN3D::make_adversarial_points(v.layer, n_random, params.seed), n_random);
+
+    v.halo     = 0.05 * params.spacing;
+    v.nearest  = 0.5 * params.spacing;
+
+    URBAN3D::load_polygons(v.layer, v.polys);
+    v.edges.build(v.polys);
+
+    // prism bounds: unbounded, bounded below, above, or on both sides (on the Z of some points)
+    std::mt19937 rng (params.seed);
+    std::uniform_real_distribution<double> uz (0.0, 30.0);
+
+    std::vector<double> zmin (v.polys.num_polygons()), zmax (v.polys.num_polygons());
+
+    for (size_t pid=0; pid < zmin.size(); pid++)
+    {
+        double a = uz(rng), b = v.zs[rng() % v.zs.size()];
+
+        zmin[pid] = (pid % 4 == 1 || pid % 4 == 3) ? std::min(a, b) : -DBL_MAX;
+        zmax[pid] = (pid % 4 == 2 || pid % 4 == 3) ? std::max(a, b) :  DBL_MAX;
+
+        v.priorities.push_back(double(rng() % 8));
+    }
+
+    v.prism_polys = v.polys;
+    v.prism_polys.set_z_bounds(zmin, zmax);
+
+    // reference
+    v.build_reference();
+
+    // the tessellation of the grid cells, for the mesh classifier
+    Verifier m;
+
+    m.layer = URBAN3D::make_adversarial_cells(params);
+    m.set_points(URBAN3D::make_adversarial_points(m.layer, n_random, params.seed), n_random);
+    m.build_reference();
+
+    URBAN3D::MeshLocator locator (to_mesh(m.layer));
+
+    std::cout << v.layer.num_features() << " polygons, " << v.num_points() << " points ("
+              << v.num_points() - n_random << " on or next to the geometry)" << std::endl;
+    std::cout << m.layer.num_features() << " mesh cells, " << m.num_points() << " points ("
+              << m.num_points() - n_random << " on or next to the cells)" << std::endl;
+
+    int prev_threads = omp_get_max_threads();
+
+    for (int t : thread_counts)
+    {
+        omp_set_num_threads(t);
+        verify_classifiers(v, t);
+        verify_mesh(m, locator, t);
+    }
+
+    omp_set_num_threads(prev_threads);
+
+#ifdef PIP_WITH_GDAL
+    verify_ogr(v);
+#endif
+
+    size_t n_checks = v.n_checks + m.n_checks;
+    size_t n_failed = v.n_failed + m.n_failed;
+
+    std::cout << n_checks - n_failed << " / " << n_checks << " checks passed" << std::endl;
+
+    return n_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,441 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "synthetic.h"
+
+#include <liblas/liblas.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+GISGeometryBuffer make_footprints (const SyntheticLayerParams &params)
+{
+    std::mt19937 rng(params.seed);
+    std::uniform_real_distribution<double> jitter(0.7, 1.0);
+
+    uint n_cols = std::max(1u, uint(std::ceil(std::sqrt(double(params.n_polygons)))));
+
+    double radius   = 0.4 * params.spacing;
+    uint   n_verts  = std::max(3u, params.n_vertices);
+    uint   h_verts  = std::max(4u, n_verts / 2);
+
+    // holes on a circle of radius 0.4*r, small enough not to touch each other nor the exterior ring
+    double h_dist   = 0.4 * radius;
+    double h_radius = 0.15 * radius;
+    if (params.n_holes > 1)
+        h_radius = std::min(h_radius, 0.9 * h_dist * std::sin(M_PI / params.n_holes));
+
+    GISGeometryBuffer layer;
+    layer.reserve(params.n_polygons, size_t(params.n_polygons) * (n_verts + 1 + params.n_holes * (h_verts + 1)));
+
+    for (uint pid=0; pid < params.n_polygons; pid++)
+    {
+        double cx = (pid % n_cols + 0.5) * params.spacing;
+        double cy = (pid / n_cols + 0.5) * params.spacing;
+
+        layer.begin_feature();
+        layer.begin_part();
+
+        // exterior ring, clockwise
+        layer.begin_ring();
+
+        std::vector<cinolib::vec3d> ring;
+        for (uint k=0; k < n_verts; k++)
+        {
+            double a = -2.0 * M_PI * k / n_verts;
+            double r = radius * jitter(rng);
+            ring.push_back(cinolib::vec3d(cx + r * std::cos(a), cy + r * std::sin(a), 0.0));
+        }
+        ring.push_back(ring.front());
+
+        for (const cinolib::vec3d &p : ring)
+            layer.add_coord(p);
+
+        // holes, counter-clockwise
+        if (params.n_holes == 1)
+            h_dist = 0.0;
+
+        for (uint h=0; h < params.n_holes; h++)
+        {
+            double hx = cx + h_dist * std::cos(2.0 * M_PI * h / params.n_holes);
+            double hy = cy + h_dist * std::sin(2.0 * M_PI * h / params.n_holes);
+
+            layer.begin_ring();
+
+            for (uint k=0; k <= h_verts; k++)
+            {
+                double a = 2.0 * M_PI * (k % h_verts) / h_verts;
+                layer.add_coord(cinolib::vec3d(hx + h_radius * std::cos(a), hy + h_radius * std::sin(a), 0.0));
+            }
+        }
+    }
+
+    return layer;
+}
+
+PIP_INLINE
+BBox2 layer_extent (const GISGeometryBuffer &layer)
+{
+    BBox2 extent;
+
+    for (const cinolib::vec3d &p : layer.coordinates())
+        extent.add(p.x(), p.y());
+
+    return extent;
+}
+
+PIP_INLINE
+std::vector<cinolib::vec3d> make_points (const GISGeometryBuffer &layer, const size_t n_points,
+                                         const PointDistribution distribution, const uint seed)
+{
+    std::mt19937 rng(seed);
+
+    BBox2 extent = layer_extent(layer);
+
+    std::uniform_real_distribution<double> ux(extent.xmin, extent.xmax);
+    std::uniform_real_distribution<double> uy(extent.ymin, extent.ymax);
+    std::uniform_real_distribution<double> uz(0.0, 30.0);
+
+    std::vector<cinolib::vec3d> points;
+    points.reserve(n_points);
+
+    switch (distribution)
+    {
+    case UNIFORM_POINTS:
+    {
+        for (size_t i=0; i < n_points; i++)
+            points.push_back(cinolib::vec3d(ux(rng), uy(rng), uz(rng)));
+        break;
+    }
+    case CLUSTERED_POINTS:
+    {
+        size_t n_features = std::max(size_t(1), layer.num_features());
+        size_t n_clusters = std::max(size_t(1), n_features / 10);
+
+        double sigma = 0.25 * std::sqrt((extent.xmax - extent.xmin) * (extent.ymax - extent.ymin) / n_features);
+
+        std::uniform_int_distribution<size_t> pick(0, n_features-1);
+        std::normal_distribution<double> offset(0.0, sigma);
+
+        std::vector<cinolib::vec3d> centers;
+        for (size_t c=0; c < n_clusters; c++)
+        {
+            GISSpan<const cinolib::vec3d> ring = layer.feature_first_ring(pick(rng));
+            cinolib::vec3d center(0,0,0);
+            for (const cinolib::vec3d &p : ring)
+                center = center + p;
+            centers.push_back(ring.empty() ? cinolib::vec3d(ux(rng), uy(rng), 0) : center / double(ring.size()));
+        }
+
+        std::uniform_int_distribution<size_t> pick_center(0, n_clusters-1);
+
+        for (size_t i=0; i < n_points; i++)
+        {
+            const cinolib::vec3d &c = centers.at(pick_center(rng));
+            points.push_back(cinolib::vec3d(c.x() + offset(rng), c.y() + offset(rng), uz(rng)));
+        }
+        break;
+    }
+    case SCANLINE_POINTS:
+    {
+        double w = std::max(extent.xmax - extent.xmin, 1e-9);
+        double h = std::max(extent.ymax - extent.ymin, 1e-9);
+
+        size_t n_rows = std::max(size_t(1), size_t(std::sqrt(double(n_points) * h / w)));
+        size_t per_row = std::max(size_t(1), n_points / n_rows);
+
+        double dx = w / per_row;
+        double dy = h / n_rows;
+
+        std::uniform_real_distribution<double> j(-0.25, 0.25);
+
+        for (size_t i=0; i < n_points; i++)
+        {
+            size_t row = (i / per_row) % n_rows;
+            size_t col = i % per_row;
+
+            // alternate sweep direction, as a zig-zag scanner does
+            if (row % 2 == 1)
+                col = per_row - 1 - col;
+
+            points.push_back(cinolib::vec3d(extent.xmin + (col + 0.5 + j(rng)) * dx,
+                                            extent.ymin + (row + 0.5 + j(rng)) * dy,
+                                            uz(rng)));
+        }
+        break;
+    }
+    }
+
+    return points;
+}
+
+// closed ring of the points (u,v) of the unit square, mapped to the cell with corner (x0,y0) and side s
+PIP_INLINE
+void add_unit_ring (GISGeometryBuffer &layer, const std::vector<std::pair<double,double>> &uv,
+                           const double x0, const double y0, const double s)
+{
+    layer.begin_ring();
+
+    for (const auto &p : uv)
+        layer.add_coord(cinolib::vec3d(x0 + p.first * s, y0 + p.second * s, 0.0));
+
+    layer.add_coord(cinolib::vec3d(x0 + uv.front().first * s, y0 + uv.front().second * s, 0.0));
+}
+
+// corner of the adversarial grid, and its number of columns
+const double ADVERSARIAL_ORIGIN_X = 500000.0;
+const double ADVERSARIAL_ORIGIN_Y = 4500000.0;
+
+PIP_INLINE
+uint adversarial_columns (const SyntheticLayerParams &params)
+{
+    return std::max(1u, uint(std::ceil(std::sqrt(double(params.n_polygons)))));
+}
+
+PIP_INLINE
+GISGeometryBuffer make_adversarial_footprints (const SyntheticLayerParams &params)
+{
+    const double s = params.spacing;
+
+    uint n_cols = adversarial_columns(params);
+
+    GISGeometryBuffer layer;
+
+    for (uint pid=0; pid < params.n_polygons; pid++)
+    {
+        double x0 = ADVERSARIAL_ORIGIN_X + (pid % n_cols) * s;
+        double y0 = ADVERSARIAL_ORIGIN_Y + (pid / n_cols) * s;
+
+        layer.begin_feature();
+        layer.begin_part();
+
+        switch (pid % 5)
+        {
+        case 0: // the whole cell, with collinear vertices along the sides
+            add_unit_ring(layer, {{0,0}, {0,0.5}, {0,1}, {0.25,1}, {0.5,1}, {1,1}, {1,0.75}, {1,0}, {0.75,0}, {0.25,0}}, x0, y0, s);
+            break;
+
+        case 1: // holes, with a horizontal edge at the Y of two exterior vertices
+            add_unit_ring(layer, {{0.1,0.1}, {0.1,0.5}, {0.1,0.9}, {0.9,0.9}, {0.9,0.5}, {0.9,0.1}}, x0, y0, s);
+            add_unit_ring(layer, {{0.3,0.3}, {0.7,0.3}, {0.7,0.5}, {0.3,0.5}}, x0, y0, s);
+            add_unit_ring(layer, {{0.6,0.6}, {0.8,0.6}, {0.7,0.8}}, x0, y0, s);
+            break;
+
+        case 2: // a triangle, a square with a hole and an island inside the hole
+            add_unit_ring(layer, {{0.05,0.05}, {0.25,0.45}, {0.45,0.05}}, x0, y0, s);
+            layer.begin_part();
+            add_unit_ring(layer, {{0.5,0.5}, {0.5,0.95}, {0.95,0.95}, {0.95,0.5}}, x0, y0, s);
+            add_unit_ring(layer, {{0.6,0.6}, {0.85,0.6}, {0.85,0.85}, {0.6,0.85}}, x0, y0, s);
+            layer.begin_part();
+            add_unit_ring(layer, {{0.65,0.65}, {0.65,0.8}, {0.8,0.8}, {0.8,0.65}}, x0, y0, s);
+            break;
+
+        case 3: // comb: teeth with their tops and gaps at the same Y, a repeated vertex
+            add_unit_ring(layer, {{0.1,0.1}, {0.1,0.9}, {0.3,0.9}, {0.3,0.5}, {0.5,0.5}, {0.5,0.9}, {0.7,0.9},
+                                  {0.7,0.5}, {0.7,0.5}, {0.8,0.5}, {0.9,0.5}, {0.9,0.1}, {0.5,0.1}}, x0, y0, s);
+            break;
+
+        case 4: // diamond overlapping the neighbour cells, its vertices on their sides
+            add_unit_ring(layer, {{-0.5,0.5}, {0.5,1.5}, {1.5,0.5}, {0.5,-0.5}}, x0, y0, s);
+            break;
+        }
+    }
+
+    return layer;
+}
+
+PIP_INLINE
+GISGeometryBuffer make_adversarial_cells (const SyntheticLayerParams &params)
+{
+    const double s = params.spacing;
+
+    uint n_cols = adversarial_columns(params);
+    uint n_rows = std::max(1u, (params.n_polygons + n_cols - 1) / n_cols);
+
+    // computed once per grid line, so that neighbour cells get the same corners
+    auto gx = [&](const uint i) { return ADVERSARIAL_ORIGIN_X + i * s; };
+    auto gy = [&](const uint j) { return ADVERSARIAL_ORIGIN_Y + j * s; };
+
+    GISGeometryBuffer cells;
+
+    for (uint j=0; j < n_rows; j++)
+    {
+        for (uint i=0; i < n_cols; i++)
+        {
+            cells.begin_feature();
+            cells.begin_part();
+            cells.begin_ring();
+
+            cells.add_coord(cinolib::vec3d(gx(i),   gy(j),   0.0));
+            cells.add_coord(cinolib::vec3d(gx(i+1), gy(j),   0.0));
+            cells.add_coord(cinolib::vec3d(gx(i+1), gy(j+1), 0.0));
+            cells.add_coord(cinolib::vec3d(gx(i),   gy(j+1), 0.0));
+            cells.add_coord(cinolib::vec3d(gx(i),   gy(j),   0.0));
+        }
+    }
+
+    return cells;
+}
+
+PIP_INLINE
+std::vector<cinolib::vec3d> make_adversarial_points (const GISGeometryBuffer &layer, const size_t n_random, const uint seed)
+{
+    std::mt19937 rng(seed);
+
+    BBox2 extent = layer_extent(layer);
+
+    std::uniform_real_distribution<double> ux(extent.xmin, extent.xmax);
+    std::uniform_real_distribution<double> uy(extent.ymin, extent.ymax);
+    std::uniform_real_distribution<double> uz(0.0, 30.0);
+
+    std::vector<cinolib::vec3d> points;
+
+    for (size_t r=0; r < layer.num_rings(); r++)
+    {
+        GISSpan<const cinolib::vec3d> ring = layer.ring(r);
+
+        for (size_t i=0; i < ring.size(); i++)
+        {
+            const double x = ring[i].x(), y = ring[i].y();
+
+            points.push_back(cinolib::vec3d(x, y, uz(rng)));
+            points.push_back(cinolib::vec3d(std::nextafter(x, -DBL_MAX), y, uz(rng)));
+            points.push_back(cinolib::vec3d(std::nextafter(x,  DBL_MAX), y, uz(rng)));
+            points.push_back(cinolib::vec3d(x, std::nextafter(y, -DBL_MAX), uz(rng)));
+            points.push_back(cinolib::vec3d(x, std::nextafter(y,  DBL_MAX), uz(rng)));
+
+            // the ray of this point goes through the vertex
+            points.push_back(cinolib::vec3d(ux(rng), y, uz(rng)));
+
+            if (i+1 < ring.size())
+            {
+                const cinolib::vec3d &q = ring[i+1];
+                points.push_back(cinolib::vec3d(0.5 * (x + q.x()), 0.5 * (y + q.y()), uz(rng)));
+                points.push_back(cinolib::vec3d(x + (q.x() - x) / 3.0, y + (q.y() - y) / 3.0, uz(rng)));
+            }
+        }
+    }
+
+    for (size_t i=0; i < n_random; i++)
+        points.push_back(cinolib::vec3d(ux(rng), uy(rng), uz(rng)));
+
+    return points;
+}
+
+PIP_INLINE
+std::vector<SHPObject*> make_shp_objects (const GISGeometryBuffer &layer)
+{
+    std::vector<SHPObject*> objects;
+    objects.reserve(layer.num_features());
+
+    std::vector<int> part_start;
+    std::vector<double> xs, ys, zs;
+
+    for (size_t fid=0; fid < layer.num_features(); fid++)
+    {
+        part_start.clear();
+        xs.clear();
+        ys.clear();
+        zs.clear();
+
+        uint64_t ring_begin = layer.part_ring_begin(layer.feature_part_begin(fid));
+        uint64_t ring_end   = layer.part_ring_begin(layer.feature_part_end(fid));
+
+        for (uint64_t r=ring_begin; r < ring_end; r++)
+        {
+            part_start.push_back(xs.size());
+
+            for (const cinolib::vec3d &p : layer.ring(r))
+            {
+                xs.push_back(p.x());
+                ys.push_back(p.y());
+                zs.push_back(p.z());
+            }
+        }
+
+        objects.push_back(SHPCreateObject(SHPT_POLYGON, fid, part_start.size(), part_start.data(), nullptr,
+                                          xs.size(), xs.data(), ys.data(), zs.data(), nullptr));
+    }
+
+    return objects;
+}
+
+PIP_INLINE
+bool write_shapefile (const std::string &filename, const GISGeometryBuffer &layer)
+{
+    SHPHandle hSHP = SHPCreate(filename.c_str(), SHPT_POLYGON);
+
+    if (hSHP == nullptr)
+    {
+        std::cerr << "Error creating shapefile " << filename << std::endl;
+        return false;
+    }
+
+    for (SHPObject *obj : make_shp_objects(layer))
+    {
+        SHPWriteObject(hSHP, -1, obj);
+        SHPDestroyObject(obj);
+    }
+
+    SHPClose(hSHP);
+
+    return true;
+}
+
+PIP_INLINE
+bool write_las (const std::string &filename, const std::vector<cinolib::vec3d> &points)
+{
+    std::ofstream ofs(filename, std::ios::out | std::ios::binary);
+
+    if (!ofs.is_open())
+    {
+        std::cerr << "Error opening output LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    double min[3] = { DBL_MAX,  DBL_MAX,  DBL_MAX};
+    double max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+
+    for (const cinolib::vec3d &p : points)
+        for (uint i=0; i < 3; i++)
+        {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        }
+
+    liblas::Header header;
+    header.SetScale(0.01, 0.01, 0.01);
+    header.SetOffset(points.empty() ? 0.0 : min[0], points.empty() ? 0.0 : min[1], 0.0);
+    header.SetPointRecordsCount(points.size());
+
+    if (!points.empty())
+    {
+        header.SetMin(min[0], min[1], min[2]);
+        header.SetMax(max[0], max[1], max[2]);
+    }
+
+    liblas::Writer writer(ofs, header);
+    liblas::Point pt(&header);
+
+    for (const cinolib::vec3d &p : points)
+    {
+        pt.SetCoordinates(p.x(), p.y(), p.z());
+        writer.WritePoint(pt);
+    }
+
+    return true;
+}
+
+}
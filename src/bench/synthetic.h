@@ -0,0 +1,84 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include "../utils/pip_inline.h"
+#include "../io/gis_geometry.h"
+#include "../partitioning/region_grid.h"
+
+#include <shapefil.h>
+
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Synthetic workloads for benchmarking: footprint layers laid out on a regular
+// grid (one star-shaped polygon per grid cell, optionally with holes) and point
+// clouds covering the layer extent.
+
+class SyntheticLayerParams
+{
+public:
+    uint n_polygons = 1000;
+    uint n_vertices = 16;   // vertices of the exterior ring
+    uint n_holes    = 0;    // holes per polygon
+    double spacing  = 20.0; // size of the grid cell hosting each polygon
+    uint seed       = 42;
+};
+
+enum PointDistribution
+{
+    UNIFORM_POINTS,   // uniform over the layer extent
+    CLUSTERED_POINTS, // gaussian blobs around random footprints
+    SCANLINE_POINTS   // row by row sweep, as in an airborne acquisition
+};
+
+// closed rings: exterior ring clockwise, holes counter-clockwise (shapefile convention)
+GISGeometryBuffer make_footprints (const SyntheticLayerParams &params);
+
+BBox2 layer_extent (const GISGeometryBuffer &layer);
+
+std::vector<cinolib::vec3d> make_points (const GISGeometryBuffer &layer, const size_t n_points,
+                                         const PointDistribution distribution, const uint seed = 42);
+
+// Adversarial layer for correctness checks, one shape per grid cell of side params.spacing,
+// cycling through: rectangles filling their cell (shared edges, collinear vertices along
+// the sides), polygons with holes (horizontal hole edges at the Y of exterior vertices),
+// multipart polygons (an island inside the hole of another part), combs (runs of horizontal
+// edges at the same Y, repeated vertices) and diamonds overlapping their neighbours.
+// The layer lies at UTM-like coordinates, away from the origin.
+GISGeometryBuffer make_adversarial_footprints (const SyntheticLayerParams &params);
+
+// The grid cells hosting the shapes of make_adversarial_footprints() (shape pid in column
+// pid % n_cols, row pid / n_cols), completed to a rectangle of n_cols x n_rows cells:
+// one closed counter-clockwise ring per cell, row by row. Neighbour cells share their
+// corners exactly, so the cells are a tessellation (see the mesh check of pip_verify).
+GISGeometryBuffer make_adversarial_cells (const SyntheticLayerParams &params);
+
+// Points on and around the geometry of a layer: every vertex and its closest neighbours
+// in each direction, points on every edge, points at the Y of every vertex, followed
+// by n_random points uniform over the layer extent (the last n_random of the list)
+std::vector<cinolib::vec3d> make_adversarial_points (const GISGeometryBuffer &layer, const size_t n_random,
+                                                     const uint seed = 42);
+
+// one SHPObject per feature, one shapefile part per ring (release with SHPDestroyObject)
+std::vector<SHPObject*> make_shp_objects (const GISGeometryBuffer &layer);
+
+bool write_shapefile (const std::string &filename, const GISGeometryBuffer &layer);
+bool write_las (const std::string &filename, const std::vector<cinolib::vec3d> &points);
+
+}
+
+#ifndef static_lib
+#include "synthetic.cpp"
+#endif
+
+#endif // SYNTHETIC_H
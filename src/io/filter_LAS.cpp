@@ -0,0 +1,149 @@
+#include "filter_LAS.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace URBAN3D
+{
+
+// "a:b", "a:", ":b" -> [a, b], the missing bounds left unchanged
+PIP_INLINE
+bool parse_range (const std::string &s, double &lo, double &hi)
+{
+    size_t colon = s.find(':');
+
+    if (colon == std::string::npos)
+        return false;
+
+    try
+    {
+        std::string a = s.substr(0, colon);
+        std::string b = s.substr(colon+1);
+
+        size_t n;
+        if (!a.empty()) { lo = std::stod(a, &n); if (n != a.size()) return false; }
+        if (!b.empty()) { hi = std::stod(b, &n); if (n != b.size()) return false; }
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+
+    return lo <= hi;
+}
+
+// "2,6,9" -> bits 2, 6, 9 of mask (values up to max_value)
+template<class T>
+bool parse_mask (const std::string &s, const uint max_value, T &mask)
+{
+    mask = 0;
+
+    std::stringstream ss (s);
+    std::string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        size_t n;
+        unsigned long v;
+
+        try { v = std::stoul(item, &n); }
+        catch (const std::exception &) { return false; }
+
+        if (n != item.size() || v > max_value)
+            return false;
+
+        mask |= T(1) << v;
+    }
+
+    return mask != 0;
+}
+
+PIP_INLINE
+bool LASFilter::parse (const std::string &s)
+{
+    *this = LASFilter();
+
+    std::stringstream ss (s);
+    std::string clause;
+
+    while (std::getline(ss, clause, ';'))
+    {
+        if (clause.empty())
+            continue;
+
+        size_t eq = clause.find('=');
+        std::string key   = clause.substr(0, std::min(eq, clause.size()));
+        std::string value = eq == std::string::npos ? "" : clause.substr(eq+1);
+
+        bool ok;
+
+        if      (key == "class")     ok = parse_mask(value, 31, class_mask);
+        else if (key == "return")    ok = parse_mask(value, 7, return_mask);
+        else if (key == "z")         ok = parse_range(value, z_min, z_max);
+        else if (key == "time")      ok = parse_range(value, time_min, time_max);
+        else if (key == "intensity") ok = parse_range(value, intensity_min, intensity_max);
+        else ok = false;
+
+        if (!ok)
+        {
+            std::cerr << "Invalid filter clause: " << clause << std::endl;
+            return false;
+        }
+    }
+
+    expression = s;
+    return true;
+}
+
+PIP_INLINE
+bool LASFilter::compile (const liblas::Header &header, LASPredicate &pred) const
+{
+    pred = LASPredicate();
+
+    if (empty())
+        return true;
+
+    const int format = header.GetDataFormatId();
+
+    if (format < 0 || format > 5)
+    {
+        std::cerr << "Point filters need LAS point formats 0-5 (format " << format << ")" << std::endl;
+        return false;
+    }
+
+    pred.active      = true;
+    pred.class_mask  = class_mask;
+    pred.return_mask = return_mask;
+
+    // Z bounds to raw integer coordinates: z = raw * scale + offset
+    const double scale  = header.GetScaleZ();
+    const double offset = header.GetOffsetZ();
+
+    if (z_min > -DBL_MAX) pred.z_min = int64_t(std::max(std::ceil ((z_min - offset) / scale), double(INT32_MIN) - 1));
+    if (z_max <  DBL_MAX) pred.z_max = int64_t(std::min(std::floor((z_max - offset) / scale), double(INT32_MAX) + 1));
+
+    pred.intensity_min = uint16_t(std::max(0.0, std::ceil(intensity_min)));
+    pred.intensity_max = uint16_t(std::min(double(UINT16_MAX), std::floor(intensity_max)));
+
+    if (intensity_min > UINT16_MAX || intensity_max < 0)
+        pred.intensity_min = 1, pred.intensity_max = 0;
+
+    if (time_min > -DBL_MAX || time_max < DBL_MAX)
+    {
+        if (format == 0 || format == 2)
+        {
+            std::cerr << "Point format " << format << " has no GPS time" << std::endl;
+            return false;
+        }
+
+        pred.check_time = true;
+        pred.time_min = time_min;
+        pred.time_max = time_max;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef FILTER_LAS_H
+#define FILTER_LAS_H
+
+#include "../utils/pip_inline.h"
+
+#include <liblas/liblas.hpp>
+
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace URBAN3D
+{
+
+// Predicate on the raw records of a LAS file (point formats 0-5), compiled from a
+// LASFilter for a given header: integer comparisons on the record fields, combined
+// without branches
+class LASPredicate
+{
+public:
+
+    bool     active = false;       // false: every point passes
+    uint32_t class_mask  = ~0u;    // bit c: classification c passes
+    uint8_t  return_mask = 0xFF;   // bit r: return number r passes
+    int64_t  z_min = INT64_MIN, z_max = INT64_MAX;   // raw (scaled) Z
+    uint16_t intensity_min = 0, intensity_max = UINT16_MAX;
+    bool     check_time = false;
+    double   time_min = -DBL_MAX, time_max = DBL_MAX;
+
+    bool accept (const uint8_t *record) const
+    {
+        int32_t  z;
+        uint16_t intensity;
+        memcpy(&z, record + 8, sizeof(z));
+        memcpy(&intensity, record + 12, sizeof(intensity));
+
+        bool ok = ((class_mask >> (record[15] & 31)) & 1) &
+                  ((return_mask >> (record[14] & 7)) & 1) &
+                  (z >= z_min) & (z <= z_max) &
+                  (intensity >= intensity_min) & (intensity <= intensity_max);
+
+        if (check_time)
+        {
+            double t;
+            memcpy(&t, record + 20, sizeof(t));
+            ok &= (t >= time_min) & (t <= time_max);
+        }
+
+        return ok;
+    }
+
+    bool accept (const liblas::Point &p) const { return !active || accept(p.GetData().data()); }
+};
+
+// Selection of the points to partition, on their LAS fields. Parsed from an expression
+// of ';'-separated clauses, all of which must hold:
+//   class=2,6       classification in the list
+//   return=1,2      return number in the list
+//   z=10:50         Z in [10, 50] (either bound may be omitted, e.g. z=10:)
+//   time=a:b        GPS time in [a, b] (point formats 1, 3, 4, 5)
+//   intensity=a:b   intensity in [a, b]
+class LASFilter
+{
+public:
+
+    uint32_t class_mask  = ~0u;
+    uint8_t  return_mask = 0xFF;
+    double   z_min = -DBL_MAX, z_max = DBL_MAX;
+    double   time_min = -DBL_MAX, time_max = DBL_MAX;
+    double   intensity_min = 0, intensity_max = UINT16_MAX;
+
+    std::string expression;   // as parsed, empty if no filter
+
+    bool empty () const { return expression.empty(); }
+
+    bool parse (const std::string &s);
+
+    // predicate for the records of a file with the given header
+    // (false if the point format does not have the fields used)
+    bool compile (const liblas::Header &header, LASPredicate &pred) const;
+};
+
+}
+
+#ifndef static_lib
+#include "filter_LAS.cpp"
+#endif
+
+#endif
@@ -3,9 +3,11 @@
 #include "ogrsf_frmts.h"
 
 #include <cinolib/merge_meshes_at_coincident_vertices.h>
+#include <algorithm>
 #include <filesystem>
 
 
+PIP_INLINE
 void SafeCopyShapefile(const std::string& src, const std::string& dst)
 {
     // Remove all existing files with the same base name
@@ -49,6 +51,214 @@ void SafeCopyShapefile(const std::string& src, const std::string& dst)
 }
 
 
+PIP_INLINE
+void GISAttributeTable::clear ()
+{
+    names.clear();
+    types.clear();
+    slots.clear();
+    int_cols.clear();
+    int64_cols.clear();
+    double_cols.clear();
+    string_pools.clear();
+    string_offsets.clear();
+    rows = 0;
+}
+
+PIP_INLINE
+void GISAttributeTable::reserve (const size_t n)
+{
+    for (auto &c : int_cols)       c.reserve(n);
+    for (auto &c : int64_cols)     c.reserve(n);
+    for (auto &c : double_cols)    c.reserve(n);
+    for (auto &c : string_offsets) c.reserve(n+1);
+}
+
+PIP_INLINE
+uint GISAttributeTable::add_field (const std::string &name, const GISFieldType type)
+{
+    int existing = field_index(name);
+    if (existing >= 0)
+        return existing;
+
+    names.push_back(name);
+    types.push_back(type);
+
+    switch (type)
+    {
+    case GIS_FIELD_INT:
+        slots.push_back(int_cols.size());
+        int_cols.push_back(std::vector<int>(rows, 0));
+        break;
+    case GIS_FIELD_INT64:
+        slots.push_back(int64_cols.size());
+        int64_cols.push_back(std::vector<int64_t>(rows, 0));
+        break;
+    case GIS_FIELD_DOUBLE:
+        slots.push_back(double_cols.size());
+        double_cols.push_back(std::vector<double>(rows, 0.0));
+        break;
+    case GIS_FIELD_STRING:
+        slots.push_back(string_pools.size());
+        string_pools.push_back(std::string());
+        string_offsets.push_back(std::vector<uint64_t>(rows+1, 0));
+        break;
+    }
+
+    return names.size()-1;
+}
+
+PIP_INLINE
+int GISAttributeTable::field_index (const std::string &name) const
+{
+    for (uint f=0; f < names.size(); f++)
+        if (names.at(f) == name)
+            return f;
+    return -1;
+}
+
+PIP_INLINE
+void GISAttributeTable::begin_row ()
+{
+    for (auto &c : int_cols)    c.push_back(0);
+    for (auto &c : int64_cols)  c.push_back(0);
+    for (auto &c : double_cols) c.push_back(0.0);
+
+    for (uint c=0; c < string_pools.size(); c++)
+        string_offsets.at(c).push_back(string_pools.at(c).size());
+
+    rows++;
+}
+
+PIP_INLINE
+void GISAttributeTable::set_string (const uint f, const char *v)
+{
+    uint c = slots.at(f);
+    string_pools.at(c).append(v);
+    string_offsets.at(c).back() = string_pools.at(c).size();
+}
+
+PIP_INLINE
+int GISAttributeTable::get_int (const size_t row, const uint f) const
+{
+    return static_cast<int>(get_int64(row, f));
+}
+
+PIP_INLINE
+int64_t GISAttributeTable::get_int64 (const size_t row, const uint f) const
+{
+    switch (types.at(f))
+    {
+    case GIS_FIELD_INT:    return int_cols.at(slots.at(f)).at(row);
+    case GIS_FIELD_INT64:  return int64_cols.at(slots.at(f)).at(row);
+    case GIS_FIELD_DOUBLE: return static_cast<int64_t>(double_cols.at(slots.at(f)).at(row));
+    case GIS_FIELD_STRING: return std::strtoll(std::string(get_string(row, f)).c_str(), nullptr, 10);
+    }
+    return 0;
+}
+
+PIP_INLINE
+double GISAttributeTable::get_double (const size_t row, const uint f) const
+{
+    switch (types.at(f))
+    {
+    case GIS_FIELD_INT:    return int_cols.at(slots.at(f)).at(row);
+    case GIS_FIELD_INT64:  return static_cast<double>(int64_cols.at(slots.at(f)).at(row));
+    case GIS_FIELD_DOUBLE: return double_cols.at(slots.at(f)).at(row);
+    case GIS_FIELD_STRING: return std::strtod(std::string(get_string(row, f)).c_str(), nullptr);
+    }
+    return 0.0;
+}
+
+PIP_INLINE
+std::string_view GISAttributeTable::get_string (const size_t row, const uint f) const
+{
+    if (types.at(f) != GIS_FIELD_STRING)
+        return std::string_view();
+
+    uint c = slots.at(f);
+    uint64_t begin = string_offsets.at(c).at(row);
+    uint64_t end   = string_offsets.at(c).at(row+1);
+
+    return std::string_view(string_pools.at(c).data() + begin, end - begin);
+}
+
+PIP_INLINE
+void GISAttributeTable::add_row (const std::vector<GISDataField> &fields)
+{
+    std::vector<uint> ids;
+    ids.reserve(fields.size());
+
+    for (const GISDataField &field : fields)
+    {
+        GISFieldType type = GIS_FIELD_STRING;
+
+        if (field.type == "int")         type = GIS_FIELD_INT;
+        else if (field.type == "int64")  type = GIS_FIELD_INT64;
+        else if (field.type == "double") type = GIS_FIELD_DOUBLE;
+
+        ids.push_back(add_field(field.name, type));
+    }
+
+    begin_row();
+
+    for (uint i=0; i < fields.size(); i++)
+    {
+        const std::string &value = fields.at(i).value;
+
+        switch (types.at(ids.at(i)))
+        {
+        case GIS_FIELD_INT:    set_int   (ids.at(i), std::atoi(value.c_str())); break;
+        case GIS_FIELD_INT64:  set_int64 (ids.at(i), std::strtoll(value.c_str(), nullptr, 10)); break;
+        case GIS_FIELD_DOUBLE: set_double(ids.at(i), std::strtod(value.c_str(), nullptr)); break;
+        case GIS_FIELD_STRING: set_string(ids.at(i), value.c_str()); break;
+        }
+    }
+}
+
+PIP_INLINE
+GISDataField GISAttributeTable::get_field (const size_t row, const uint f) const
+{
+    GISDataField field;
+    field.name = names.at(f);
+
+    switch (types.at(f))
+    {
+    case GIS_FIELD_INT:
+        field.type  = "int";
+        field.value = std::to_string(get_int(row, f));
+        break;
+    case GIS_FIELD_INT64:
+        field.type  = "int64";
+        field.value = std::to_string(get_int64(row, f));
+        break;
+    case GIS_FIELD_DOUBLE:
+        field.type  = "double";
+        field.value = std::to_string(get_double(row, f));
+        break;
+    case GIS_FIELD_STRING:
+        field.type  = "string";
+        field.value = std::string(get_string(row, f));
+        break;
+    }
+
+    return field;
+}
+
+PIP_INLINE
+std::vector<GISDataField> GISAttributeTable::get_row (const size_t row) const
+{
+    std::vector<GISDataField> fields;
+    fields.reserve(names.size());
+
+    for (uint f=0; f < names.size(); f++)
+        fields.push_back(get_field(row, f));
+
+    return fields;
+}
+
+
+PIP_INLINE
 GISData::GISData(const std::string i_filename, const std::string o_filename)
 {
     GDALDataset *ds = read(i_filename, GDAL_OF_VECTOR);
@@ -85,12 +295,14 @@ GISData::GISData(const std::string i_filename, const std::string o_filename)
 //     }
 }
 
-inline
+PIP_INLINE
 GDALDataset * GISData::read(const std::string filename, unsigned int nOpenFlags)
 {
     lines.clear();
     points.clear();
     polygons.clear();
+    lines_attributes.clear();
+    polygons_attributes.clear();
 
     GDALAllRegister();
 
@@ -146,8 +358,6 @@ GDALDataset * GISData::read(const std::string filename, unsigned int nOpenFlags)
             set_epsg(poLayer->GetSpatialRef()->GetEPSGGeogCS());
         }
 
-        OGRFeatureDefn *poFDefn = poLayer->GetLayerDefn();
-
         // 3. Reading features from the layer
 
         OGRFeature *poFeature;
@@ -156,29 +366,14 @@ GDALDataset * GISData::read(const std::string filename, unsigned int nOpenFlags)
         int numFeature = poLayer->GetFeatureCount();
         std::cout << "GDAL - Number of features: " << numFeature << std::endl;
 
-        while( (poFeature = poLayer->GetNextFeature()) != NULL )
-        {
-            for( int iField = 0; iField < poFDefn->GetFieldCount(); iField++ )
-            {
-                OGRFieldDefn *poFieldDefn = poFDefn->GetFieldDefn( iField );
+        // -1 if the driver cannot tell without a full scan
+        const size_t n_expected = numFeature > 0 ? size_t(numFeature) : 0;
 
-                switch( poFieldDefn->GetType() )
-                {
-                case OFTInteger:
-                    break;
-                case OFTInteger64:
-                    break;
-                case OFTReal:
-                    break;
-                case OFTString:
-                    break;
-                default:
-                    break;
-                }
-
-                std::string field_name = poFieldDefn->GetNameRef();
-            }
+        // layer field -> table column, resolved once per layer on first use
+        std::vector<int> lines_map, polygons_map;
 
+        while( (poFeature = poLayer->GetNextFeature()) != NULL )
+        {
             // Extract geometry from the feature
             OGRGeometry *poGeometry = poFeature->GetGeometryRef();
 
@@ -198,208 +393,157 @@ GDALDataset * GISData::read(const std::string filename, unsigned int nOpenFlags)
             }
             else if (poGeometry != NULL && wkbFlatten(poGeometry->getGeometryType()) == wkbLineString)
             {
-                // std::cout << "Geometry Type: LINE" << std::endl;
+                lines.begin_feature();
+                lines.begin_part();
+                read_ring((OGRLineString*) poGeometry, lines);
 
-                OGRLineString *ls = (OGRLineString*) poGeometry;
-                // OGRLineString* ls = (OGRLineString*)poGeometry->Boundary();
+                // Read and store data fields
+                read_attributes(poFeature, lines_map, lines_attributes, n_expected);
+            }
+            else if (poGeometry != NULL && wkbFlatten(poGeometry->getGeometryType()) == wkbMultiLineString)
+            {
+                OGRMultiLineString *mls = (OGRMultiLineString*) poGeometry;
 
-                std::vector<cinolib::vec3d> line;
+                lines.begin_feature();
 
-                for(int i = 0; i < ls->getNumPoints(); i++ )
+                for (int g=0; g < mls->getNumGeometries(); g++)
                 {
-                    OGRPoint p;
-                    ls->getPoint(i, &p);
-
-                    cinolib::vec3d point;
-                    point.x() = p.getX();
-                    point.y() = p.getY();
-                    point.z() = p.getZ();
-
-                    line.push_back(point);
+                    lines.begin_part();
+                    read_ring((OGRLineString*) mls->getGeometryRef(g), lines);
                 }
 
-                add_line(line);
+                // Read and store data fields
+                read_attributes(poFeature, lines_map, lines_attributes, n_expected);
+            }
+            else if (poGeometry != NULL && wkbFlatten(poGeometry->getGeometryType()) == wkbPolygon)
+            {
+                polygons.begin_feature();
+                read_polygon_part((OGRPolygon*) poGeometry, polygons);
 
                 // Read and store data fields
-                std::vector<GISDataField> fields;
+                read_attributes(poFeature, polygons_map, polygons_attributes, n_expected);
+            }
+            else if (poGeometry != NULL && wkbFlatten(poGeometry->getGeometryType()) == wkbMultiPolygon)
+            {
+                OGRMultiPolygon *mp = (OGRMultiPolygon*) poGeometry;
 
-                for (uint f=0; f < poFeature->GetFieldCount(); f++)
-                {
-                    GISDataField field;
-                    field.name = poFeature->GetFieldDefnRef(f)->GetNameRef();
-
-                    if (poFeature->GetFieldDefnRef(f)->GetType() == OFTString)
-                    {
-                        field.value = poFeature->GetFieldAsString(f);
-                        field.type = "string";
-                    }
-                    else
-                        if (poFeature->GetFieldDefnRef(f)->GetType() == OFTInteger)
-                        {
-                            field.value = std::to_string(poFeature->GetFieldAsInteger(f));
-                            field.type = "int";
-                        }
-                        else
-                            if (poFeature->GetFieldDefnRef(f)->GetType() == OFTInteger64)
-                            {
-                                field.value = std::to_string(poFeature->GetFieldAsInteger64(f));
-                                field.type = "int64";
-                            }
-                            else
-                                if (poFeature->GetFieldDefnRef(f)->GetType() == OFTReal)
-                                {
-                                    field.value = std::to_string(poFeature->GetFieldAsDouble(f));
-                                    field.type = "double";
-                                }
-
-                    fields.push_back(field);
-                }
+                polygons.begin_feature();
+
+                for (int g=0; g < mp->getNumGeometries(); g++)
+                    read_polygon_part((OGRPolygon*) mp->getGeometryRef(g), polygons);
 
-                add_line_field(fields);
+                // Read and store data fields
+                read_attributes(poFeature, polygons_map, polygons_attributes, n_expected);
             }
-            else if (poGeometry != NULL && wkbFlatten(poGeometry->getGeometryType()) == wkbPolygon)
-            {
-                // std::cout << "Geometry Type: POLYGON" << std::endl;
 
-                OGRPolygon *ls = (OGRPolygon*) poGeometry;
-                // OGRLineString* ls = (OGRLineString*)poGeometry->Boundary();
+            OGRFeature::DestroyFeature( poFeature );
+        }
+    }
 
-                std::vector<cinolib::vec3d> polygon;
+    // GDALClose(ds);
 
-                // std::cout << "Number of points: " << ls->getExteriorRing()->getNumPoints() << std::endl;
+    std::cout << "Load - completed." << std::endl;
 
-                for(int i = 0; i < ls->getExteriorRing()->getNumPoints(); i++ )
-                {
-                    OGRPoint p;
-                    ls->getExteriorRing()->getPoint(i,&p);
+    return ds;
+}
 
-                    cinolib::vec3d point;
-                    point.x() = p.getX();
-                    point.y() = p.getY();
-                    point.z() = p.getZ();
+PIP_INLINE
+void GISData::read_ring (OGRLineString *ls, GISGeometryBuffer &buffer)
+{
+    buffer.begin_ring();
 
-                    polygon.push_back(point);
-                }
+    for (int i=0; i < ls->getNumPoints(); i++)
+        buffer.add_coord(cinolib::vec3d(ls->getX(i), ls->getY(i), ls->getZ(i)));
+}
 
-                add_polygon(polygon);
+PIP_INLINE
+void GISData::read_polygon_part (OGRPolygon *poly, GISGeometryBuffer &buffer)
+{
+    buffer.begin_part();
 
-                // Read and store data fields
-                std::vector<GISDataField> fields;
+    if (poly->getExteriorRing() == nullptr)
+        return;
 
-                for (uint f=0; f < poFeature->GetFieldCount(); f++)
-                {
-                    GISDataField field;
-                    field.name = poFeature->GetFieldDefnRef(f)->GetNameRef();
-
-                    if (poFeature->GetFieldDefnRef(f)->GetType() == OFTString)
-                    {
-                        field.value = poFeature->GetFieldAsString(f);
-                        field.type = "string";
-                    }
-                    else
-                        if (poFeature->GetFieldDefnRef(f)->GetType() == OFTInteger)
-                        {
-                            field.value = std::to_string(poFeature->GetFieldAsInteger(f));
-                            field.type = "int";
-                        }
-                        else
-                            if (poFeature->GetFieldDefnRef(f)->GetType() == OFTInteger64)
-                            {
-                                field.value = std::to_string(poFeature->GetFieldAsInteger64(f));
-                                field.type = "int64";
-                            }
-                            else
-                                if (poFeature->GetFieldDefnRef(f)->GetType() == OFTReal)
-                                {
-                                    field.value = std::to_string(poFeature->GetFieldAsDouble(f));
-                                    field.type = "double";
-                                }
-
-                    fields.push_back(field);
-                }
+    read_ring(poly->getExteriorRing(), buffer);
 
-                add_polygon_field(fields);
-            }
-            else
-            {
-                // std::cout << poGeometry->getGeometryType() << "; name = " << poGeometry->getGeometryName() << std::endl;
-                // std::cerr << "Unsupported." << std::endl;
-                // return false;
+    for (int r=0; r < poly->getNumInteriorRings(); r++)
+        read_ring(poly->getInteriorRing(r), buffer);
+}
 
-                // std::cout << "Geometry Type: POLYGON" << std::endl;
+PIP_INLINE
+void GISData::read_attributes (OGRFeature *poFeature, std::vector<int> &field_map, GISAttributeTable &table,
+                                const size_t n_expected)
+{
+    int nFields = poFeature->GetFieldCount();
 
-                OGRMultiPolygon *ls = (OGRMultiPolygon*) poGeometry;
-                // OGRLineString* ls = (OGRLineString*)poGeometry->Boundary();
+    if (field_map.empty() && nFields > 0)
+    {
+        OGRFeatureDefn *poFDefn = poFeature->GetDefnRef();
 
-                std::vector<cinolib::vec3d> polygon;
+        for (int f=0; f < nFields; f++)
+        {
+            OGRFieldDefn *poFieldDefn = poFDefn->GetFieldDefn(f);
 
-                // std::cout << "Number of points: " << ls->getExteriorRing()->getNumPoints() << std::endl;
+            GISFieldType type;
 
-                // for(int i = 0; i < ls->get->getExteriorRing()->getNumPoints(); i++ )
-                // {
-                //     OGRPoint p;
-                //     ls->getExteriorRing()->getPoint(i,&p);
+            switch (poFieldDefn->GetType())
+            {
+            case OFTInteger:   type = GIS_FIELD_INT;    break;
+            case OFTInteger64: type = GIS_FIELD_INT64;  break;
+            case OFTReal:      type = GIS_FIELD_DOUBLE; break;
+            default:           type = GIS_FIELD_STRING; break;
+            }
 
-                //     cinolib::vec3d point;
-                //     point.x() = p.getX();
-                //     point.y() = p.getY();
-                //     point.z() = p.getZ();
+            field_map.push_back(table.add_field(poFieldDefn->GetNameRef(), type));
+        }
 
-                //     polygon.push_back(point);
-                // }
+        table.reserve(table.num_rows() + n_expected);
+    }
 
-                //add_polygon(polygon);
+    table.begin_row();
 
-                // Read and store data fields
-                std::vector<GISDataField> fields;
+    for (int f=0; f < nFields; f++)
+    {
+        if (!poFeature->IsFieldSetAndNotNull(f))
+            continue;
 
-                for (uint f=0; f < poFeature->GetFieldCount(); f++)
-                {
-                    GISDataField field;
-                    field.name = poFeature->GetFieldDefnRef(f)->GetNameRef();
-
-                    if (poFeature->GetFieldDefnRef(f)->GetType() == OFTString)
-                    {
-                        field.value = poFeature->GetFieldAsString(f);
-                        field.type = "string";
-                    }
-                    else
-                        if (poFeature->GetFieldDefnRef(f)->GetType() == OFTInteger)
-                        {
-                            field.value = std::to_string(poFeature->GetFieldAsInteger(f));
-                            field.type = "int";
-                        }
-                        else
-                            if (poFeature->GetFieldDefnRef(f)->GetType() == OFTInteger64)
-                            {
-                                field.value = std::to_string(poFeature->GetFieldAsInteger64(f));
-                                field.type = "int64";
-                            }
-                            else
-                                if (poFeature->GetFieldDefnRef(f)->GetType() == OFTReal)
-                                {
-                                    field.value = std::to_string(poFeature->GetFieldAsDouble(f));
-                                    field.type = "double";
-                                }
-
-                    fields.push_back(field);
-                }
+        uint col = field_map.at(f);
 
-                add_polygon_field(fields);
-            }
+        switch (table.field_type(col))
+        {
+        case GIS_FIELD_INT:    table.set_int   (col, poFeature->GetFieldAsInteger(f));   break;
+        case GIS_FIELD_INT64:  table.set_int64 (col, poFeature->GetFieldAsInteger64(f)); break;
+        case GIS_FIELD_DOUBLE: table.set_double(col, poFeature->GetFieldAsDouble(f));    break;
+        case GIS_FIELD_STRING: table.set_string(col, poFeature->GetFieldAsString(f));    break;
         }
-
-        OGRFeature::DestroyFeature( poFeature );
     }
+}
 
-    // GDALClose(ds);
+PIP_INLINE
+std::vector<std::vector<GISDataField>> GISData::get_lines_fields () const
+{
+    std::vector<std::vector<GISDataField>> fields;
+    fields.reserve(lines_attributes.num_rows());
 
-    std::cout << "Load - completed." << std::endl;
+    for (size_t row=0; row < lines_attributes.num_rows(); row++)
+        fields.push_back(lines_attributes.get_row(row));
 
-    return ds;
+    return fields;
 }
 
-inline
+PIP_INLINE
+std::vector<std::vector<GISDataField>> GISData::get_polygons_fields () const
+{
+    std::vector<std::vector<GISDataField>> fields;
+    fields.reserve(polygons_attributes.num_rows());
+
+    for (size_t row=0; row < polygons_attributes.num_rows(); row++)
+        fields.push_back(polygons_attributes.get_row(row));
+
+    return fields;
+}
+
+PIP_INLINE
 GISData::GISData (const cinolib::Polygonmesh<> &m, const uint m_epsg)
 {
     for (uint pid=0; pid < m.num_polys(); pid++)
@@ -411,83 +555,80 @@ GISData::GISData (const cinolib::Polygonmesh<> &m, const uint m_epsg)
 
         polygon.push_back(polygon.at(0));
 
-        polygons.push_back(polygon);
-        polygons_fields.push_back(std::vector<GISDataField>());
+        polygons.add_feature(polygon);
+        polygons_attributes.begin_row();
     }
 
     epsg = m_epsg;
 }
 
-inline
-bool GISData::convert_to_epsg (const uint epsg_target)
+// Transforms a contiguous range of coordinates in batches, instead of one Transform call per vertex.
+// As in the original per-point code, y and x are passed swapped to follow the EPSG axis order.
+PIP_INLINE
+bool transform_coords (OGRCoordinateTransformation *poCT, GISSpan<cinolib::vec3d> coords)
 {
-    std::cout << __FUNCTION__ << std::endl;
-    OGRSpatialReference oSourceSRS, oTargetSRS;
-
-    oTargetSRS.importFromEPSG ( epsg_target );
-    oSourceSRS.importFromEPSG( epsg );
-
-    std::cout << "original epsg: " << epsg << std::endl;
-    std::cout << "target epsg: " << epsg_target << std::endl;
-
-    OGRCoordinateTransformation *poCT = OGRCreateCoordinateTransformation( &oSourceSRS, &oTargetSRS );
+    const size_t batch = 65536;
 
-    double x, y;
+    std::vector<double> xs, ys;
+    xs.reserve(std::min(batch, coords.size()));
+    ys.reserve(std::min(batch, coords.size()));
 
-    for (uint p=0; p < points.size(); p++)
+    for (size_t begin=0; begin < coords.size(); begin += batch)
     {
-        x = points.at(p).x();
-        y = points.at(p).y();
+        size_t end = std::min(begin + batch, coords.size());
 
-        // std::cout << x << ", " << y << std::endl;
+        xs.clear();
+        ys.clear();
 
-        if (!poCT->Transform( 1, &y, &x ))
+        for (size_t i=begin; i < end; i++)
         {
-            std::cerr << "EPSG conversione error." << std::endl;
-            return false;
+            xs.push_back(coords[i].x());
+            ys.push_back(coords[i].y());
         }
 
-        points.at(p).x() = x;
-        points.at(p).y() = y;
+        if (!poCT->Transform( end - begin, ys.data(), xs.data() ))
+            return false;
+
+        for (size_t i=begin; i < end; i++)
+        {
+            coords[i].x() = xs.at(i-begin);
+            coords[i].y() = ys.at(i-begin);
+        }
     }
 
+    return true;
+}
 
-    for (uint l=0; l < lines.size(); l++)
-    {
-        for (uint p=0; p < lines.at(l).size(); p++)
-        {
-            x = lines.at(l).at(p).x();
-            y = lines.at(l).at(p).y();
+PIP_INLINE
+bool GISData::convert_to_epsg (const uint epsg_target)
+{
+    std::cout << __FUNCTION__ << std::endl;
+    OGRSpatialReference oSourceSRS, oTargetSRS;
 
-            // std::cout << x << ", " << y << std::endl;
+    oTargetSRS.importFromEPSG ( epsg_target );
+    oSourceSRS.importFromEPSG( epsg );
 
-            if (!poCT->Transform( 1, &y, &x ))
-            {
-                std::cerr << "EPSG conversione error." << std::endl;
-                return false;
-            }
+    std::cout << "original epsg: " << epsg << std::endl;
+    std::cout << "target epsg: " << epsg_target << std::endl;
 
-            lines.at(l).at(p).x() = x;
-            lines.at(l).at(p).y() = y;
-        }
-    }
+    OGRCoordinateTransformation *poCT = OGRCreateCoordinateTransformation( &oSourceSRS, &oTargetSRS );
 
-    for (uint b=0; b < polygons.size(); b++)
+    if (poCT == nullptr)
     {
-        for (uint p=0; p < polygons.at(b).size(); p++)
-        {
-            x = polygons.at(b).at(p).x();
-            y = polygons.at(b).at(p).y();
+        std::cerr << "EPSG conversione error." << std::endl;
+        return false;
+    }
 
-            if (!poCT->Transform( 1, &y, &x ))
-            {
-                std::cerr << "EPSG conversione error." << std::endl;
-                return false;
-            }
+    bool ok = transform_coords(poCT, GISSpan<cinolib::vec3d>(points.data(), points.size())) &&
+              transform_coords(poCT, lines.coordinates()) &&
+              transform_coords(poCT, polygons.coordinates());
 
-            polygons.at(b).at(p).x() = x;
-            polygons.at(b).at(p).y() = y;
-        }
+    OGRCoordinateTransformation::DestroyCT(poCT);
+
+    if (!ok)
+    {
+        std::cerr << "EPSG conversione error." << std::endl;
+        return false;
     }
 
     epsg = epsg_target;
@@ -495,22 +636,25 @@ bool GISData::convert_to_epsg (const uint epsg_target)
     return true;
 }
 
-inline
+PIP_INLINE
 cinolib::Polygonmesh<> GISData::convert_to_polygon_mesh () const
 {
     cinolib::Polygonmesh<> mesh;
 
-    if (!polygons.empty())
-    for (uint p=0; p < polygons.size(); p++)
+    for (uint p=0; p < polygons.num_features(); p++)
     {
         std::vector<unsigned int> vert_ids;
 
         // cinolib::Polygonmesh<> tmp;
 
-        if(!polygons.empty())
-        for (uint pp=0; pp < polygons.at(p).size()-1; pp++)
+        GISSpan<const cinolib::vec3d> ring = polygons.feature_first_ring(p);
+
+        if (ring.empty())
+            continue;
+
+        for (uint pp=0; pp < ring.size()-1; pp++)
         {
-            unsigned int id = mesh.vert_add(polygons.at(p).at(pp));
+            unsigned int id = mesh.vert_add(ring[pp]);
             vert_ids.push_back(id);
         }
 
@@ -540,7 +684,7 @@ cinolib::Polygonmesh<> GISData::convert_to_polygon_mesh () const
     return mesh;
 }
 
-inline
+PIP_INLINE
 void GISData::set_z_from_mesh (const cinolib::Polygonmesh<> &mesh)
 {
     cinolib::Octree octree;
@@ -549,57 +693,33 @@ void GISData::set_z_from_mesh (const cinolib::Polygonmesh<> &mesh)
     set_z_from_octree(octree);
 }
 
-inline
-void GISData::set_z_from_octree (const cinolib::Octree &octree)
+PIP_INLINE
+void set_z_from_octree_coords (const cinolib::Octree &octree, GISSpan<cinolib::vec3d> coords)
 {
-    std::cout << __FUNCTION__ << std::endl;
-
-    double x, y;
-
-    double dist;
-    uint id;
-
-    for (uint a=0; a < points.size(); a++)
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int64_t i=0; i < (int64_t) coords.size(); i++)
     {
-        x = points.at(a).x();
-        y = points.at(a).y();
+        double dist;
+        uint id;
 
-        if (octree.intersects_ray(cinolib::vec3d(x, y, 0), cinolib::vec3d(0,0,1), dist, id))
-            points.at(a).z() = dist;
+        if (octree.intersects_ray(cinolib::vec3d(coords[i].x(), coords[i].y(), 0), cinolib::vec3d(0,0,1), dist, id))
+            coords[i].z() = dist;
         else
-            points.at(a).z() = DBL_MAX;
-    }
-
-    for (uint l=0; l < lines.size(); l++)
-    {
-        for (uint p=0; p < lines.at(l).size(); p++)
-        {
-            x = lines.at(l).at(p).x();
-            y = lines.at(l).at(p).y();
-
-            if (octree.intersects_ray(cinolib::vec3d(x, y, 0), cinolib::vec3d(0,0,1), dist, id))
-                lines.at(l).at(p).z() = dist;
-            else
-                lines.at(l).at(p).z() = DBL_MAX;
-        }
+            coords[i].z() = DBL_MAX;
     }
+}
 
-    for (uint b=0; b < polygons.size(); b++)
-    {
-        for (uint p=0; p < polygons.at(b).size(); p++)
-        {
-            x = polygons.at(b).at(p).x();
-            y = polygons.at(b).at(p).y();
+PIP_INLINE
+void GISData::set_z_from_octree (const cinolib::Octree &octree)
+{
+    std::cout << __FUNCTION__ << std::endl;
 
-            if (octree.intersects_ray(cinolib::vec3d(x, y, 0), cinolib::vec3d(0,0,1), dist, id))
-                polygons.at(b).at(p).z() = dist;
-            else
-                polygons.at(b).at(p).z() = DBL_MAX;
-        }
-    }
+    set_z_from_octree_coords(octree, GISSpan<cinolib::vec3d>(points.data(), points.size()));
+    set_z_from_octree_coords(octree, lines.coordinates());
+    set_z_from_octree_coords(octree, polygons.coordinates());
 }
 
-inline
+PIP_INLINE
 void GISData::add_field_to_layer (const std::vector<double> &f, const std::string &layer_name, const std::string &field_name)
 {
     std::cout << __FUNCTION__ << std::endl;
@@ -696,7 +816,7 @@ void GISData::add_field_to_layer (const std::vector<double> &f, const std::strin
     write();
 }
 
-inline
+PIP_INLINE
 bool GISData::write ()
 {
     GDALClose( poDS_out );
@@ -2,11 +2,15 @@
 #define GIS_DATA_H
 
 #include "gdal_priv.h"
+#include "../utils/pip_inline.h"
+#include "gis_geometry.h"
 #include <cinolib/geometry/vec_mat.h>
 
 #include <cinolib/meshes/polygonmesh.h>
 #include <cinolib/octree.h>
 
+#include <string_view>
+
 class GISDataField
 {
 public:
@@ -15,6 +19,67 @@ public:
     std::string value;
 };
 
+enum GISFieldType
+{
+    GIS_FIELD_INT,
+    GIS_FIELD_INT64,
+    GIS_FIELD_DOUBLE,
+    GIS_FIELD_STRING
+};
+
+// Column-oriented attribute storage: one typed array per field, one row per feature.
+// Field names and types are stored once in the schema; string values of a column
+// are packed in a single buffer addressed by offsets.
+class GISAttributeTable
+{
+private:
+
+    std::vector<std::string>  names;
+    std::vector<GISFieldType> types;
+    std::vector<uint>         slots; // position of each field in its typed column set
+
+    std::vector<std::vector<int>>      int_cols;
+    std::vector<std::vector<int64_t>>  int64_cols;
+    std::vector<std::vector<double>>   double_cols;
+    std::vector<std::string>           string_pools;
+    std::vector<std::vector<uint64_t>> string_offsets; // num_rows+1 offsets per string column
+
+    size_t rows = 0;
+
+public:
+
+    void clear ();
+    void reserve (const size_t n);
+
+    uint add_field (const std::string &name, const GISFieldType type);
+    int  field_index (const std::string &name) const;
+
+    uint num_fields () const { return names.size(); }
+    size_t num_rows () const { return rows; }
+
+    const std::string & field_name (const uint f) const { return names.at(f); }
+    GISFieldType field_type (const uint f) const { return types.at(f); }
+
+    // appends a row with default values (0 or empty string) in every column;
+    // setters below always write into the last row
+    void begin_row ();
+
+    void set_int    (const uint f, const int v)     { int_cols.at(slots.at(f)).back() = v; }
+    void set_int64  (const uint f, const int64_t v) { int64_cols.at(slots.at(f)).back() = v; }
+    void set_double (const uint f, const double v)  { double_cols.at(slots.at(f)).back() = v; }
+    void set_string (const uint f, const char *v);
+
+    int              get_int    (const size_t row, const uint f) const;
+    int64_t          get_int64  (const size_t row, const uint f) const;
+    double           get_double (const size_t row, const uint f) const;
+    std::string_view get_string (const size_t row, const uint f) const;
+
+    // row-wise compatibility layer (allocates one string triple per value)
+    void add_row (const std::vector<GISDataField> &fields);
+    GISDataField get_field (const size_t row, const uint f) const;
+    std::vector<GISDataField> get_row (const size_t row) const;
+};
+
 class GISData
 {
 private:
@@ -29,11 +94,17 @@ private:
     unsigned int epsg;
 
     std::vector<cinolib::vec3d> points;
-    std::vector<std::vector<cinolib::vec3d>> lines;
-    std::vector<std::vector<GISDataField>> lines_fields;
+    GISGeometryBuffer lines;
+    GISAttributeTable lines_attributes;
+
+    GISGeometryBuffer polygons;
+    GISAttributeTable polygons_attributes;
 
-    std::vector<std::vector<cinolib::vec3d>> polygons;
-    std::vector<std::vector<GISDataField>> polygons_fields;
+    void read_ring (OGRLineString *ls, GISGeometryBuffer &buffer);
+    void read_polygon_part (OGRPolygon *poly, GISGeometryBuffer &buffer);
+    // n_expected: rows the layer will add to table, reserved when its columns are created
+    void read_attributes (OGRFeature *poFeature, std::vector<int> &field_map, GISAttributeTable &table,
+                          const size_t n_expected);
 
 public:
 
@@ -53,24 +124,28 @@ public:
     const std::vector<cinolib::vec3d>& get_points () const {return points; }
     const cinolib::vec3d& get_point (const uint i) const {return points.at(i); }
 
-    const std::vector<std::vector<cinolib::vec3d>> & get_lines () const {return lines;}
-    const std::vector<cinolib::vec3d> & get_line (const uint i) const {return lines.at(i);}
-    const std::vector<std::vector<GISDataField>> & get_lines_fields () const {return lines_fields;}
-    const std::vector<GISDataField> & get_line_fields (const uint i) const {return lines_fields.at(i);}
+    size_t num_lines () const {return lines.num_features();}
+    const GISGeometryBuffer & get_lines () const {return lines;}
+    GISSpan<const cinolib::vec3d> get_line (const uint i) const {return lines.feature_first_ring(i);}
+    const GISAttributeTable & get_lines_attributes () const {return lines_attributes;}
+    std::vector<std::vector<GISDataField>> get_lines_fields () const;
+    std::vector<GISDataField> get_line_fields (const uint i) const {return lines_attributes.get_row(i);}
 
-    const std::vector<std::vector<cinolib::vec3d>> & get_polygons () const {return polygons;}
-    const std::vector<cinolib::vec3d> & get_polygon (const uint i) const {return polygons.at(i);}
+    size_t num_polygons () const {return polygons.num_features();}
+    const GISGeometryBuffer & get_polygons () const {return polygons;}
+    GISSpan<const cinolib::vec3d> get_polygon (const uint i) const {return polygons.feature_first_ring(i);}
 
-    const std::vector<std::vector<GISDataField>> & get_polygons_fields () const {return polygons_fields;}
-    const std::vector<GISDataField> & get_polygon_fields (const uint i) const {return polygons_fields.at(i);}
+    const GISAttributeTable & get_polygons_attributes () const {return polygons_attributes;}
+    std::vector<std::vector<GISDataField>> get_polygons_fields () const;
+    std::vector<GISDataField> get_polygon_fields (const uint i) const {return polygons_attributes.get_row(i);}
 
     ////
 
     void add_point (const cinolib::vec3d &p) { points.push_back(p); }
-    void add_line (const std::vector<cinolib::vec3d> &l) { lines.push_back(l); }
-    void add_polygon (const std::vector<cinolib::vec3d> &p) { polygons.push_back(p); }
-    void add_polygon_field (const std::vector<GISDataField> &fields ) { polygons_fields.push_back(fields); }
-    void add_line_field (const std::vector<GISDataField> &fields ) { lines_fields.push_back(fields); }
+    void add_line (const std::vector<cinolib::vec3d> &l) { lines.add_feature(l); }
+    void add_polygon (const std::vector<cinolib::vec3d> &p) { polygons.add_feature(p); }
+    void add_polygon_field (const std::vector<GISDataField> &fields ) { polygons_attributes.add_row(fields); }
+    void add_line_field (const std::vector<GISDataField> &fields ) { lines_attributes.add_row(fields); }
 
 
     bool convert_to_epsg(const uint epsg_target);
@@ -82,7 +157,7 @@ public:
 
 };
 
-#ifndef STATIC_VIEWER
+#if !defined(STATIC_VIEWER) && !defined(static_lib)
 #include "gis_data.cpp"
 #endif
 
@@ -0,0 +1,92 @@
+#include "gis_geometry.h"
+
+PIP_INLINE
+void GISGeometryBuffer::clear ()
+{
+    coords.clear();
+    feature_offsets.assign(1, 0);
+    part_offsets.assign(1, 0);
+    ring_offsets.assign(1, 0);
+}
+
+PIP_INLINE
+void GISGeometryBuffer::reserve (const size_t n_features, const size_t n_coords)
+{
+    feature_offsets.reserve(n_features+1);
+    part_offsets.reserve(n_features+1);
+    ring_offsets.reserve(n_features+1);
+    coords.reserve(n_coords);
+}
+
+PIP_INLINE
+void GISGeometryBuffer::begin_feature ()
+{
+    feature_offsets.push_back(feature_offsets.back());
+}
+
+PIP_INLINE
+void GISGeometryBuffer::begin_part ()
+{
+    feature_offsets.back()++;
+    part_offsets.push_back(part_offsets.back());
+}
+
+PIP_INLINE
+void GISGeometryBuffer::begin_ring ()
+{
+    part_offsets.back()++;
+    ring_offsets.push_back(ring_offsets.back());
+}
+
+PIP_INLINE
+void GISGeometryBuffer::add_coord (const cinolib::vec3d &p)
+{
+    coords.push_back(p);
+    ring_offsets.back()++;
+}
+
+PIP_INLINE
+void GISGeometryBuffer::add_feature (const std::vector<cinolib::vec3d> &ring)
+{
+    begin_feature();
+    begin_part();
+    begin_ring();
+
+    coords.insert(coords.end(), ring.begin(), ring.end());
+    ring_offsets.back() += ring.size();
+}
+
+PIP_INLINE
+GISSpan<const cinolib::vec3d> GISGeometryBuffer::ring (const size_t r) const
+{
+    uint64_t begin = ring_offsets.at(r);
+    uint64_t end   = ring_offsets.at(r+1);
+
+    return GISSpan<const cinolib::vec3d>(coords.data() + begin, end - begin);
+}
+
+PIP_INLINE
+GISSpan<const cinolib::vec3d> GISGeometryBuffer::feature_coords (const size_t f) const
+{
+    uint64_t first_ring = part_offsets.at(feature_offsets.at(f));
+    uint64_t last_ring  = part_offsets.at(feature_offsets.at(f+1));
+
+    uint64_t begin = ring_offsets.at(first_ring);
+    uint64_t end   = ring_offsets.at(last_ring);
+
+    return GISSpan<const cinolib::vec3d>(coords.data() + begin, end - begin);
+}
+
+PIP_INLINE
+GISSpan<const cinolib::vec3d> GISGeometryBuffer::feature_first_ring (const size_t f) const
+{
+    if (feature_offsets.at(f) == feature_offsets.at(f+1))
+        return GISSpan<const cinolib::vec3d>();
+
+    uint64_t first_ring = part_offsets.at(feature_offsets.at(f));
+
+    if (first_ring == part_offsets.at(feature_offsets.at(f)+1))
+        return GISSpan<const cinolib::vec3d>();
+
+    return ring(first_ring);
+}
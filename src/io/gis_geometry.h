@@ -0,0 +1,101 @@
+#ifndef GIS_GEOMETRY_H
+#define GIS_GEOMETRY_H
+
+#include "../utils/pip_inline.h"
+#include <cinolib/geometry/vec_mat.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Non-owning view over a contiguous range of elements
+template<class T>
+class GISSpan
+{
+private:
+
+    T *ptr = nullptr;
+    size_t len = 0;
+
+public:
+
+    GISSpan () {}
+    GISSpan (T *d, const size_t n) : ptr(d), len(n) {}
+
+    T * data () const { return ptr; }
+    size_t size () const { return len; }
+    bool empty () const { return len == 0; }
+
+    T * begin () const { return ptr; }
+    T * end () const { return ptr + len; }
+
+    T & operator[] (const size_t i) const { return ptr[i]; }
+
+    T & at (const size_t i) const
+    {
+        if (i >= len) throw std::out_of_range("GISSpan::at");
+        return ptr[i];
+    }
+};
+
+// CSR storage for (multi)lines and (multi)polygons: a single coordinate array
+// plus offset arrays feature -> parts -> rings -> coordinates.
+// Each offset array holds n+1 entries, so that element i spans [off[i], off[i+1]).
+// A line part has exactly one ring; a polygon part has its exterior ring first,
+// followed by its holes.
+class GISGeometryBuffer
+{
+private:
+
+    std::vector<cinolib::vec3d> coords;
+    std::vector<uint64_t> feature_offsets = {0}; // into parts
+    std::vector<uint64_t> part_offsets    = {0}; // into rings
+    std::vector<uint64_t> ring_offsets    = {0}; // into coords
+
+public:
+
+    void clear ();
+    void reserve (const size_t n_features, const size_t n_coords);
+
+    // incremental construction: each call opens a new element inside the last open one
+    void begin_feature ();
+    void begin_part ();
+    void begin_ring ();
+    void add_coord (const cinolib::vec3d &p);
+
+    // appends a single-part, single-ring feature
+    void add_feature (const std::vector<cinolib::vec3d> &ring);
+
+    size_t num_features () const { return feature_offsets.size()-1; }
+    size_t num_parts () const { return part_offsets.size()-1; }
+    size_t num_rings () const { return ring_offsets.size()-1; }
+    size_t num_coords () const { return coords.size(); }
+
+    uint64_t feature_part_begin (const size_t f) const { return feature_offsets.at(f); }
+    uint64_t feature_part_end   (const size_t f) const { return feature_offsets.at(f+1); }
+    uint64_t part_ring_begin    (const size_t p) const { return part_offsets.at(p); }
+    uint64_t part_ring_end      (const size_t p) const { return part_offsets.at(p+1); }
+    uint64_t ring_coord_begin   (const size_t r) const { return ring_offsets.at(r); }
+    uint64_t ring_coord_end     (const size_t r) const { return ring_offsets.at(r+1); }
+
+    GISSpan<const cinolib::vec3d> ring (const size_t r) const;
+
+    // all the coordinates of a feature (every ring of every part, in order)
+    GISSpan<const cinolib::vec3d> feature_coords (const size_t f) const;
+
+    // first ring of the first part of a feature (the exterior ring of a polygon)
+    GISSpan<const cinolib::vec3d> feature_first_ring (const size_t f) const;
+
+    GISSpan<const cinolib::vec3d> coordinates () const { return GISSpan<const cinolib::vec3d>(coords.data(), coords.size()); }
+    GISSpan<cinolib::vec3d> coordinates () { return GISSpan<cinolib::vec3d>(coords.data(), coords.size()); }
+
+    const std::vector<uint64_t> & get_feature_offsets () const { return feature_offsets; }
+    const std::vector<uint64_t> & get_part_offsets () const { return part_offsets; }
+    const std::vector<uint64_t> & get_ring_offsets () const { return ring_offsets; }
+};
+
+#ifndef static_lib
+#include "gis_geometry.cpp"
+#endif
+
+#endif // GIS_GEOMETRY_H
@@ -11,7 +11,7 @@ namespace Urban3D
 namespace IO
 {
 
-inline
+PIP_INLINE
 void read_GIS (const std::string filename, GISData &gis_data )
 {
     int flags = GDAL_OF_VECTOR;
@@ -1,6 +1,7 @@
 #ifndef READ_GIS_H
 #define READ_GIS_H
 
+#include "../utils/pip_inline.h"
 #include "gis_data.h"
 #include <string>
 
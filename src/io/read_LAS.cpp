@@ -0,0 +1,111 @@
+#include "read_LAS.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+size_t LAS_point_count (const liblas::Header &header, const size_t file_size)
+{
+    size_t count = header.GetPointRecordsCount();
+
+    if (count == 0 && header.GetDataRecordLength() > 0 && file_size > header.GetDataOffset())
+        count = (file_size - header.GetDataOffset()) / header.GetDataRecordLength();
+
+    return count;
+}
+
+PIP_INLINE
+size_t count_LAS_points (const std::string &filename)
+{
+    std::ifstream ifs;
+    ifs.open(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if (!ifs.is_open())
+        return 0;
+
+    liblas::Reader reader(ifs);
+    return LAS_point_count(reader.GetHeader(), fs::file_size(filename));
+}
+
+PIP_INLINE
+bool read_LAS (const std::string &filename, liblas::Header &header, std::vector<liblas::Point> &points,
+               std::vector<double> &xs, std::vector<double> &ys,
+               const size_t begin, const size_t end,
+               const LASFilter &filter)
+{
+    std::ifstream ifs;
+    ifs.open(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if (!ifs.is_open())
+    {
+        std::cerr << "Error opening LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    liblas::Reader reader(ifs);
+    header = reader.GetHeader();
+
+    size_t nPoints = LAS_point_count(header, fs::file_size(filename));
+
+    std::cout << "Number of points in the LAS file: " << nPoints << std::endl;
+
+    size_t first = std::min(begin, nPoints);
+    size_t last  = std::min(end, nPoints);
+
+    nPoints = (last > first) ? last - first : 0;
+
+    LASPredicate pred;
+
+    if (!filter.compile(header, pred))
+        return false;
+
+    points.clear();
+    xs.clear();
+    ys.clear();
+
+    // with a filter, the number of selected points is not known in advance
+    if (!pred.active)
+    {
+        points.reserve(nPoints);
+        xs.reserve(nPoints);
+        ys.reserve(nPoints);
+    }
+
+    if (first > 0 && nPoints > 0 && !reader.Seek(first))
+    {
+        std::cerr << "Error seeking point " << first << " in LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    size_t nRead = 0;
+
+    while (nRead < nPoints && reader.ReadNextPoint())
+    {
+        const liblas::Point &p = reader.GetPoint();
+        nRead++;
+
+        if (!pred.accept(p))
+            continue;
+
+        // points refer to their header: use the caller's copy, which outlives the reader
+        points.push_back(p);
+        points.back().SetHeader(&header);
+
+        xs.push_back(p.GetX());
+        ys.push_back(p.GetY());
+    }
+
+    if (pred.active)
+        std::cout << "Filter " << filter.expression << ": " << points.size() << " of " << nRead << " points selected" << std::endl;
+
+    return true;
+}
+
+}
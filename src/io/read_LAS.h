@@ -0,0 +1,39 @@
+#ifndef READ_LAS_H
+#define READ_LAS_H
+
+#include "../utils/pip_inline.h"
+#include "filter_LAS.h"
+
+#include <liblas/liblas.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Number of points of a LAS file with the given header and size in bytes: the header
+// count or, when that is 0, the number of records after the header (LAS 1.4 files
+// with more than 2^32 points store 0 in the 32-bit count)
+size_t LAS_point_count (const liblas::Header &header, const size_t file_size);
+
+// Number of points of a LAS file (0 if it cannot be opened)
+size_t count_LAS_points (const std::string &filename);
+
+// Reads the points of a LAS file, together with their XY coordinates
+// stored as separate arrays (the input of the classifier).
+// Only the points with index in [begin, end) are read (all of them by default), and
+// among them only those selected by filter, tested on the raw records as they are read.
+bool read_LAS (const std::string &filename, liblas::Header &header, std::vector<liblas::Point> &points,
+               std::vector<double> &xs, std::vector<double> &ys,
+               const size_t begin = 0, const size_t end = SIZE_MAX,
+               const LASFilter &filter = LASFilter());
+
+}
+
+#ifndef static_lib
+#include "read_LAS.cpp"
+#endif
+
+#endif
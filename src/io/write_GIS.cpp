@@ -2,94 +2,213 @@
 
 #include <ogrsf_frmts.h>
 
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 
 namespace URBAN3D
 {
 
-inline
-void write_GIS (const std::string filename, const GISData &gis_data )
+PIP_INLINE
+const char * gis_driver_from_extension (const std::string &filename)
 {
-    GDALAllRegister();
+    std::string ext = std::filesystem::path(filename).extension().string();
+
+    if (ext == ".gpkg")
+        return "GPKG";
+    if (ext == ".fgb")
+        return "FlatGeobuf";
+    if (ext == ".geojson")
+        return "GeoJSON";
+
+    return "ESRI Shapefile";
+}
+
+PIP_INLINE
+OGRFieldType gis_field_to_ogr (const GISFieldType type)
+{
+    switch (type)
+    {
+    case GIS_FIELD_INT:    return OFTInteger;
+    case GIS_FIELD_INT64:  return OFTInteger64;
+    case GIS_FIELD_DOUBLE: return OFTReal;
+    case GIS_FIELD_STRING: return OFTString;
+    }
+    return OFTString;
+}
 
-    const char *pszDriverName = "ESRI Shapefile";
-    GDALDriver *poDriver;
+// Builds the OGR polygon of part `part` of a geometry buffer, sizing each ring once
+PIP_INLINE
+OGRPolygon * make_ogr_polygon (const GISGeometryBuffer &polygons, const uint64_t part)
+{
+    OGRPolygon *poly = new OGRPolygon();
+
+    for (uint64_t r=polygons.part_ring_begin(part); r < polygons.part_ring_end(part); r++)
+    {
+        GISSpan<const cinolib::vec3d> coords = polygons.ring(r);
 
+        OGRLinearRing *ring = new OGRLinearRing();
+        ring->setNumPoints(coords.size(), FALSE);
+
+        for (uint i=0; i < coords.size(); i++)
+            ring->setPoint(i, coords[i].x(), coords[i].y(), coords[i].z());
+
+        poly->addRingDirectly(ring);
+    }
+
+    return poly;
+}
+
+PIP_INLINE
+bool write_GIS (const std::string filename, const GISData &gis_data, const uint batch_size)
+{
     GDALAllRegister();
 
-    poDriver = (GDALDriver*) GDALGetDriverByName(pszDriverName );
+    const char *pszDriverName = gis_driver_from_extension(filename);
+
+    GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName(pszDriverName);
     if( poDriver == NULL )
     {
-        printf( "%s driver not available.\n", pszDriverName );
-        exit( 1 );
+        std::cerr << pszDriverName << " driver not available." << std::endl;
+        return false;
     }
 
-    GDALDataset *poDS;
+    if (std::filesystem::exists(filename))
+        poDriver->Delete(filename.c_str());
 
-    poDS = poDriver->Create( filename.c_str() , 0, 0, 0, GDT_Unknown, NULL );
+    GDALDataset *poDS = poDriver->Create( filename.c_str() , 0, 0, 0, GDT_Unknown, NULL );
     if( poDS == NULL )
     {
-        printf( "Creation of output file failed.\n" );
-        exit( 1 );
+        std::cerr << "Creation of output file failed: " << filename << std::endl;
+        return false;
     }
 
+    const GISGeometryBuffer &polygons   = gis_data.get_polygons();
+    const GISAttributeTable &attributes = gis_data.get_polygons_attributes();
+
+    bool multipart = false;
+    for (uint pid=0; pid < polygons.num_features() && !multipart; pid++)
+        multipart = (polygons.feature_part_end(pid) - polygons.feature_part_begin(pid) > 1);
+
     // Define spatial reference
     OGRSpatialReference oSRS;
     oSRS.importFromEPSG(gis_data.get_epsg());
 
-    OGRLayer *poLayer;
-
-    poLayer = poDS->CreateLayer( "polygons_out", &oSRS, wkbPolygon, NULL );
+    OGRLayer *poLayer = poDS->CreateLayer( "polygons_out", &oSRS, multipart ? wkbMultiPolygon : wkbPolygon, NULL );
     if( poLayer == NULL )
     {
-        printf( "Layer creation failed.\n" );
-        exit( 1 );
+        std::cerr << "Layer creation failed." << std::endl;
+        GDALClose(poDS);
+        return false;
     }
 
-    OGRFieldDefn oField( "Name", OFTString );
+    // attribute schema: table field -> layer field (names may be laundered by the driver)
+    std::vector<int> layer_field (attributes.num_fields(), -1);
 
-    oField.SetWidth(32);
-
-    if( poLayer->CreateField( &oField ) != OGRERR_NONE )
+    for (uint f=0; f < attributes.num_fields(); f++)
     {
-        printf( "Creating Name field failed.\n" );
-        exit( 1 );
+        OGRFieldDefn oField( attributes.field_name(f).c_str(), gis_field_to_ogr(attributes.field_type(f)) );
+
+        if( poLayer->CreateField( &oField ) != OGRERR_NONE )
+        {
+            std::cerr << "Creating " << attributes.field_name(f) << " field failed." << std::endl;
+            continue;
+        }
+
+        layer_field.at(f) = poLayer->GetLayerDefn()->GetFieldCount()-1;
     }
 
-    for (uint pid=0; pid < gis_data.get_polygons().size(); pid++)
-    {
-        OGRFeature *poFeature;
+    bool use_transactions = (poDS->TestCapability(ODsCTransactions) != 0);
+    bool ok = true;
 
-        poFeature = OGRFeature::CreateFeature( poLayer->GetLayerDefn() );
-        // poFeature->SetField( "Name", szName );
+    if (use_transactions)
+        poDS->StartTransaction();
 
-        OGRPolygon poly;
+    // a single feature object is reused for every record
+    OGRFeature *poFeature = OGRFeature::CreateFeature( poLayer->GetLayerDefn() );
 
-        OGRLinearRing ring;
+    for (uint pid=0; pid < polygons.num_features() && ok; pid++)
+    {
+        poFeature->SetFID(OGRNullFID);
+
+        // no value left over from the previous record
+        for (int lf : layer_field)
+            if (lf >= 0)
+                poFeature->UnsetField(lf);
 
-        for (uint p=0; p < gis_data.get_polygons().at(pid).size(); p++)
-            ring.addPoint(gis_data.get_polygons().at(pid).at(p).x(),
-                          gis_data.get_polygons().at(pid).at(p).y(),
-                          gis_data.get_polygons().at(pid).at(p).z());
+        if (multipart)
+        {
+            OGRMultiPolygon *mp = new OGRMultiPolygon();
 
-        poly.addRing(&ring);
+            for (uint64_t part=polygons.feature_part_begin(pid); part < polygons.feature_part_end(pid); part++)
+                mp->addGeometryDirectly(make_ogr_polygon(polygons, part));
+
+            poFeature->SetGeometryDirectly(mp);
+        }
+        else if (polygons.feature_part_begin(pid) < polygons.feature_part_end(pid))
+            poFeature->SetGeometryDirectly(make_ogr_polygon(polygons, polygons.feature_part_begin(pid)));
+        else
+            poFeature->SetGeometryDirectly(new OGRPolygon());
 
-        poFeature->SetGeometry( &poly );
+        if (pid < attributes.num_rows())
+        {
+            for (uint f=0; f < attributes.num_fields(); f++)
+            {
+                int lf = layer_field.at(f);
+                if (lf < 0) continue;
+
+                switch (attributes.field_type(f))
+                {
+                case GIS_FIELD_INT:    poFeature->SetField(lf, attributes.get_int(pid, f)); break;
+                case GIS_FIELD_INT64:  poFeature->SetField(lf, (GIntBig) attributes.get_int64(pid, f)); break;
+                case GIS_FIELD_DOUBLE: poFeature->SetField(lf, attributes.get_double(pid, f)); break;
+                case GIS_FIELD_STRING: poFeature->SetField(lf, std::string(attributes.get_string(pid, f)).c_str()); break;
+                }
+            }
+        }
 
         if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
         {
-            printf( "Failed to create feature in shapefile.\n" );
-            exit( 1 );
+            std::cerr << "Failed to create feature " << pid << " in " << filename << std::endl;
+            ok = false;
+            break;
         }
 
-        OGRFeature::DestroyFeature( poFeature );
+        if (use_transactions && batch_size > 0 && (pid+1) % batch_size == 0)
+        {
+            if (poDS->CommitTransaction() != OGRERR_NONE)
+            {
+                std::cerr << "Failed to commit transaction in " << filename << std::endl;
+                ok = false;
+                use_transactions = false;
+                break;
+            }
+
+            poDS->StartTransaction();
+        }
     }
 
+    OGRFeature::DestroyFeature( poFeature );
+
+    if (use_transactions)
+    {
+        if (ok)
+            ok = (poDS->CommitTransaction() == OGRERR_NONE);
+        else
+            poDS->RollbackTransaction();
+    }
 
     GDALClose(poDS);
 
+    if (!ok)
+    {
+        std::cerr << "Write - failed." << std::endl;
+        return false;
+    }
+
     std::cout << "Write - completed." << std::endl;
+
+    return true;
 }
 
 } // END namespace
@@ -1,13 +1,19 @@
 #ifndef WRITE_GIS_H
 #define WRITE_GIS_H
 
+#include "../utils/pip_inline.h"
 #include "gis_data.h"
 #include <string>
 
 namespace URBAN3D
 {
 
-void write_GIS (const std::string filename, const GISData &gis_data );
+// Writes the polygons of gis_data, together with their attributes, to filename.
+// The output format follows the extension: .gpkg (GeoPackage), .fgb (FlatGeobuf),
+// .geojson (GeoJSON); anything else is written as an ESRI Shapefile.
+// On drivers supporting transactions, features are committed every batch_size features
+// (0: all of them in a single transaction).
+bool write_GIS (const std::string filename, const GISData &gis_data, const uint batch_size = 100000);
 
 } // END namespace
 
@@ -0,0 +1,321 @@
+#include "write_LAS.h"
+#include "read_LAS.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+std::string region_LAS_path (const std::string &folder, const uint pid)
+{
+    return folder + "/building" + std::to_string(pid) + "/" + std::to_string(pid) + ".las";
+}
+
+PIP_INLINE
+void LASStats::add (const liblas::Point &p)
+{
+    min[0] = std::min(min[0], p.GetX()); max[0] = std::max(max[0], p.GetX());
+    min[1] = std::min(min[1], p.GetY()); max[1] = std::max(max[1], p.GetY());
+    min[2] = std::min(min[2], p.GetZ()); max[2] = std::max(max[2], p.GetZ());
+
+    uint16_t r = p.GetReturnNumber();
+
+    if (r >= 1 && r <= 5)
+        by_return.at(r-1)++;
+
+    count++;
+}
+
+PIP_INLINE
+void LASStats::apply (liblas::Header &header) const
+{
+    // LAS 1.0-1.3 headers store 32-bit counts
+    if (count > UINT32_MAX)
+        std::cerr << "Warning: " << count << " points exceed the point count of the LAS header" << std::endl;
+
+    header.SetPointRecordsCount(count);
+
+    if (count > 0)
+    {
+        header.SetMin(min[0], min[1], min[2]);
+        header.SetMax(max[0], max[1], max[2]);
+    }
+
+    for (size_t r=0; r < by_return.size(); r++)
+        header.SetPointRecordsByReturnCount(r, by_return.at(r));
+}
+
+PIP_INLINE
+void set_header_stats (liblas::Header &header, const std::vector<liblas::Point> &points, const PointIds &ids)
+{
+    LASStats stats;
+
+    ids.for_each([&] (const uint64_t j) { stats.add(points.at(j)); });
+
+    stats.apply(header);
+}
+
+PIP_INLINE
+bool write_LAS (const std::string &filename, const liblas::Header &header,
+                const std::vector<liblas::Point> &points, const PointIds &ids)
+{
+    fs::path outFolder = fs::path(filename).parent_path();
+
+    // create output directory if it does not exist
+    if (!outFolder.empty() && !fs::exists(outFolder))
+    {
+        fs::create_directories(outFolder);
+    }
+
+    if (!outFolder.empty() && !fs::exists(outFolder))
+    {
+        std::cerr << "Error creating output directory: " << outFolder.string() << std::endl;
+        return false;
+    }
+
+    std::cout << "Writing LAS file: " << filename << std::endl;
+
+    std::ofstream outFile;
+    outFile.open(filename, std::ios::out | std::ios::binary);
+    if (!outFile.is_open())
+    {
+        std::cerr << "Error opening output LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    liblas::Header h = header;
+    set_header_stats(h, points, ids);
+
+    {
+        liblas::Writer writer(outFile, h);
+
+        ids.for_each([&] (const uint64_t j) { writer.WritePoint(points.at(j)); });
+    }
+
+    outFile.close();
+
+    return true;
+}
+
+// Byte offsets of the fields of the public header block (LAS 1.0-1.4)
+const std::streamoff LAS_POINT_COUNT     = 107;   // uint32
+const std::streamoff LAS_RETURN_COUNTS   = 111;   // 5 x uint32
+const std::streamoff LAS_BOUNDS          = 179;   // max x, min x, max y, min y, max z, min z
+const std::streamoff LAS14_POINT_COUNT   = 247;   // uint64 (LAS 1.4)
+const std::streamoff LAS14_RETURN_COUNTS = 255;   // 15 x uint64 (LAS 1.4)
+
+// Writes point count, bounds and point counts by return of stats in the header of an
+// open LAS file with the given minor version. In LAS 1.4, counts beyond 32 bits are only
+// in the 64-bit fields, and the legacy ones are set to 0 as the specification asks.
+PIP_INLINE
+void patch_LAS_header (std::fstream &f, const LASStats &stats, const int version_minor)
+{
+    auto put = [&](const std::streamoff pos, const auto v)
+    {
+        f.seekp(pos);
+        f.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    };
+
+    const bool legacy = stats.count <= UINT32_MAX;
+
+    if (!legacy && version_minor < 4)
+        std::cerr << "Warning: " << stats.count << " points exceed the point count of the LAS header" << std::endl;
+
+    if (legacy || version_minor < 4)
+    {
+        put(LAS_POINT_COUNT, uint32_t(std::min(stats.count, size_t(UINT32_MAX))));
+
+        for (size_t r=0; r < stats.by_return.size(); r++)
+            put(LAS_RETURN_COUNTS + 4 * r, stats.by_return.at(r));
+    }
+    else
+    {
+        put(LAS_POINT_COUNT, uint32_t(0));
+
+        for (size_t r=0; r < 5; r++)
+            put(LAS_RETURN_COUNTS + 4 * r, uint32_t(0));
+    }
+
+    for (int c=0; c < 3; c++)
+    {
+        put(LAS_BOUNDS + 16 * c,     stats.max[c]);
+        put(LAS_BOUNDS + 16 * c + 8, stats.min[c]);
+    }
+
+    if (version_minor >= 4)
+    {
+        put(LAS14_POINT_COUNT, uint64_t(stats.count));
+
+        // returns 6..15 are not counted: zeroed, not left as they were
+        for (size_t r=0; r < 15; r++)
+            put(LAS14_RETURN_COUNTS + 8 * r, uint64_t(r < stats.by_return.size() ? stats.by_return.at(r) : 0));
+    }
+}
+
+PIP_INLINE
+bool append_LAS (const std::string &filename, const liblas::Header &header,
+                 const std::vector<liblas::Point> &points, const PointIds &ids)
+{
+    if (!fs::exists(filename))
+        return write_LAS(filename, header, points, ids);
+
+    if (ids.empty())
+        return true;
+
+    liblas::Header file_header;
+    {
+        std::ifstream ifs (filename, std::ios::in | std::ios::binary);
+
+        if (!ifs.is_open())
+        {
+            std::cerr << "Error opening LAS file: " << filename << std::endl;
+            return false;
+        }
+
+        liblas::Reader reader(ifs);
+        file_header = reader.GetHeader();
+    }
+
+    const size_t record_size = file_header.GetDataRecordLength();
+
+    if (file_header.GetDataFormatId() != header.GetDataFormatId() || record_size != header.GetDataRecordLength())
+    {
+        std::cerr << "Cannot append to " << filename << ": point format " << header.GetDataFormatId()
+                  << " instead of " << file_header.GetDataFormatId() << std::endl;
+        return false;
+    }
+
+    const uintmax_t file_size = fs::file_size(filename);
+    const size_t    n_old     = LAS_point_count(file_header, file_size);
+    const uintmax_t end       = file_header.GetDataOffset() + uintmax_t(n_old) * record_size;
+
+    if (file_size < end)
+    {
+        std::cerr << "Cannot append to " << filename << ": the file is truncated" << std::endl;
+        return false;
+    }
+
+    // drop the records of an interrupted append
+    if (file_size > end)
+        fs::resize_file(filename, end);
+
+    std::cout << "Appending to LAS file: " << filename << " (" << ids.size() << " points)" << std::endl;
+
+    LASStats stats;
+    stats.count = n_old;
+
+    if (n_old > 0)
+    {
+        stats.min[0] = file_header.GetMinX(); stats.max[0] = file_header.GetMaxX();
+        stats.min[1] = file_header.GetMinY(); stats.max[1] = file_header.GetMaxY();
+        stats.min[2] = file_header.GetMinZ(); stats.max[2] = file_header.GetMaxZ();
+
+        std::vector<uint32_t> by_return = file_header.GetPointRecordsByReturnCount();
+        std::copy_n(by_return.begin(), std::min(by_return.size(), stats.by_return.size()), stats.by_return.begin());
+    }
+
+    // raw XYZ (the first three int32 of every point format) in the scale and offset of the file
+    const double scale[3]  = {file_header.GetScaleX(),  file_header.GetScaleY(),  file_header.GetScaleZ()};
+    const double offset[3] = {file_header.GetOffsetX(), file_header.GetOffsetY(), file_header.GetOffsetZ()};
+
+    const bool rescale = scale[0]  != header.GetScaleX()  || scale[1]  != header.GetScaleY()  || scale[2]  != header.GetScaleZ() ||
+                         offset[0] != header.GetOffsetX() || offset[1] != header.GetOffsetY() || offset[2] != header.GetOffsetZ();
+
+    std::fstream f (filename, std::ios::in | std::ios::out | std::ios::binary);
+
+    if (!f.is_open())
+    {
+        std::cerr << "Error opening LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    f.seekp(end);
+
+    std::vector<uint8_t> record (record_size);
+    liblas::Point q (&file_header);
+    bool in_range = true;
+
+    ids.for_each([&] (const uint64_t j)
+    {
+        if (!in_range) return;
+
+        const liblas::Point &p = points.at(j);
+        memcpy(record.data(), p.GetData().data(), record_size);
+
+        if (rescale)
+        {
+            const double xyz[3] = {p.GetX(), p.GetY(), p.GetZ()};
+
+            for (int c=0; c < 3; c++)
+            {
+                const double raw = std::round((xyz[c] - offset[c]) / scale[c]);
+                in_range &= raw >= INT32_MIN && raw <= INT32_MAX;
+
+                const int32_t v = in_range ? int32_t(raw) : 0;
+                memcpy(record.data() + 4 * c, &v, sizeof(v));
+            }
+        }
+
+        q.SetData(record);
+        stats.add(q);
+
+        f.write(reinterpret_cast<const char*>(record.data()), record_size);
+    });
+
+    // the header last: until then, the file holds its previous points
+    if (!in_range)
+    {
+        std::cerr << "Cannot append to " << filename << ": points outside the coordinate range of its scale and offset" << std::endl;
+        return false;
+    }
+
+    f.flush();
+    patch_LAS_header(f, stats, file_header.GetVersionMinor());
+    f.flush();
+
+    if (f.fail())
+    {
+        std::cerr << "Error writing LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+PIP_INLINE
+bool write_region_LAS (const std::string &folder, const liblas::Header &header,
+                       const std::vector<liblas::Point> &points,
+                       const std::vector<uint64_t> &offsets, const std::vector<uint> &ids,
+                       const size_t n_chunks, const bool append)
+{
+    for (uint pid=0; (pid+1) * n_chunks < offsets.size(); pid++)
+    {
+        PointIds region (ids.data(), offsets.data() + pid * n_chunks, n_chunks);
+
+        if (region.empty())
+        {
+            std::cout << "Region " << pid << (append ? " has no new points." : " has no points.") << std::endl;
+            continue;
+        }
+
+        bool ok = append ? append_LAS(region_LAS_path(folder, pid), header, points, region)
+                         : write_LAS(region_LAS_path(folder, pid), header, points, region);
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef WRITE_LAS_H
+#define WRITE_LAS_H
+
+#include "../utils/pip_inline.h"
+#include "../utils/point_ids.h"
+
+#include <liblas/liblas.hpp>
+
+#include <cfloat>
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// <folder>/building<pid>/<pid>.las
+std::string region_LAS_path (const std::string &folder, const uint pid);
+
+// Point count, bounds and point counts by return of a set of points
+class LASStats
+{
+public:
+
+    size_t count = 0;
+    double min[3] = { DBL_MAX,  DBL_MAX,  DBL_MAX};
+    double max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    std::vector<uint32_t> by_return = std::vector<uint32_t>(5, 0);
+
+    void add (const liblas::Point &p);
+
+    // sets them in a header
+    void apply (liblas::Header &header) const;
+};
+
+// Sets point count, bounds and point counts by return of a header to those of
+// the points with the given indices
+void set_header_stats (liblas::Header &header, const std::vector<liblas::Point> &points, const PointIds &ids);
+
+// Writes the points with the given indices to filename (creating its folder if needed),
+// with the given header updated by set_header_stats()
+bool write_LAS (const std::string &filename, const liblas::Header &header,
+                const std::vector<liblas::Point> &points, const PointIds &ids);
+
+// Appends the points with the given indices to a LAS file written by write_LAS() (which
+// creates it if missing): their records are written after the existing ones, then point
+// count, bounds and point counts by return are patched in the header, in place.
+// The points must have the point format of the file; their coordinates are re-encoded
+// if its scale or offset differ. Records past the point count of the header (left by an
+// interrupted append) are overwritten.
+bool append_LAS (const std::string &filename, const liblas::Header &header,
+                 const std::vector<liblas::Point> &points, const PointIds &ids);
+
+// Writes the points of each non-empty region pid to region_LAS_path(folder, pid),
+// with the header of the input cloud and the point count of the region.
+// Point indices are in chunked form (see PointIds), bucketed by (region, chunk):
+// the offsets of the points of region pid in chunk c are ids[offsets[b] .. offsets[b+1]),
+// with b = pid * n_chunks + c.
+// With append set, the points are appended to the existing outputs (see append_LAS()).
+// Returns false as soon as a region fails to be written.
+bool write_region_LAS (const std::string &folder, const liblas::Header &header,
+                       const std::vector<liblas::Point> &points,
+                       const std::vector<uint64_t> &offsets, const std::vector<uint> &ids,
+                       const size_t n_chunks = 1, const bool append = false);
+
+}
+
+#ifndef static_lib
+#include "write_LAS.cpp"
+#endif
+
+#endif
@@ -10,8 +10,7 @@
  *
  ********************************************************************************/
 
-#include "meshing/auxiliary.h"
-#include <shapefil.h>
+#include "partitioning/pip_partition.h"
 
 // #include "urban3D/utils/point_in_polygon.h"
 
@@ -33,209 +32,439 @@ namespace fs = std::filesystem;
 int main(int argc, char *argv[])
 {
     std::string polys_path   ;
+    std::string mesh_path = "";
     std::string las_path  = ""; // Not used in this example, but kept for consistency
 
     std::string output_las_folder;
 
     uint boundary_epsg;
 
+    bool profile = false;
+
+    size_t memory_budget = 0; // MB, 0 = whole cloud in memory
+
+    URBAN3D::ShardSpec shard;
+    uint n_launch = 0;
+    uint n_merge  = 0;
+
+    bool resume = false;
+
+    bool incremental = false;
+
+    bool append = false;
+
+    URBAN3D::AssignmentOptions assignment;
+
+    std::string priority_field;
+
+    URBAN3D::LASFilter filter;
+
+    std::string prism;
+
     try
     {
         // Define command line parser and arguments
         TCLAP::CmdLine cmd("PiP-Partitioning", ' ', "version 0.5");
 
         // Define main functionalities options
-        TCLAP::ValueArg<std::string> polys_arg("p", "polys", "Polygons", true, "name_ground", "string", cmd);
+        TCLAP::ValueArg<std::string> polys_arg("p", "polys", "Polygons", true, "name_ground", "string");
+        TCLAP::ValueArg<std::string> mesh_arg("m", "mesh", "Polygon mesh (e.g. OBJ, OFF) whose cells are the regions", true, "", "string");
+        cmd.xorAdd(polys_arg, mesh_arg);
 
         TCLAP::ValueArg<std::string> pc_arg("l", "las", "Point Cloud (LAS)", true, "name_pav", "string", cmd);
         TCLAP::ValueArg<std::string> o_pc_arg("L", "output-las-folder", "OutputLAS folder", true, "name_pav", "string", cmd);
 
+        TCLAP::ValueArg<size_t> memory_arg("", "memory-budget", "Process the cloud out-of-core, in tiles of about this size (MB)", false, 0, "MB", cmd);
+
+        TCLAP::ValueArg<std::string> shard_arg("", "shard", "Process only shard i of N of the input points, writing to <output-las-folder>/shard<i>", false, "", "i/N", cmd);
+        TCLAP::ValueArg<uint> launch_arg("", "launch", "Run N local shard processes, then merge their outputs", false, 0, "N", cmd);
+        TCLAP::ValueArg<uint> merge_arg("", "merge", "Merge the outputs of shards 0..N-1 (no partitioning)", false, 0, "N", cmd);
+
+        TCLAP::ValueArg<std::string> overlap_arg("", "overlap", "Region of points in overlapping polygons: first (lowest id), all, smallest (area), priority (see --priority-field)", false, "first", "policy", cmd);
+        TCLAP::ValueArg<std::string> priority_arg("", "priority-field", "Numeric attribute of the polygons giving their priority (--overlap priority)", false, "", "string", cmd);
+
+        TCLAP::ValueArg<std::string> strategy_arg("", "strategy", "Matching of points and regions: points (each point looks up its regions), polygons (each region scans a grid over the points, for few large regions), auto (picked by a cost model)", false, "auto", "strategy", cmd);
+
+        TCLAP::ValueArg<double> halo_arg("", "halo", "Also assign to each region the points outside it within this distance from its boundary", false, 0.0, "meters", cmd);
+
+        TCLAP::ValueArg<double> nearest_arg("", "nearest", "Assign the points outside every region to the nearest one within this distance; write the others to unassigned.las", false, 0.0, "meters", cmd);
+
+        TCLAP::ValueArg<std::string> prism_arg("", "prism", "Make each region the vertical prism between two Z bounds, each a sum of numbers, numeric attributes and z (vertex Z of the polygon, min for the bottom, max for the top); an empty bound is open. E.g. \"z:z+height\", \"ground:eave\"", false, "", "bottom:top", cmd);
+
+        TCLAP::ValueArg<std::string> filter_arg("", "filter", "Partition only the points whose LAS fields satisfy all the ';'-separated clauses (class=2,6 return=1 z=min:max time=min:max intensity=min:max), e.g. \"class=6;z=10:50\"", false, "", "expression", cmd);
+
+        TCLAP::SwitchArg resume_arg("", "resume", "Skip the work completed by a previous run (with --memory-budget or --launch)", cmd, false);
+
+        TCLAP::SwitchArg append_arg("", "append", "Append the points of the cloud to the outputs of a previous run (e.g. a new flight), instead of replacing them", cmd, false);
+
+        TCLAP::SwitchArg incremental_arg("", "incremental", "Rewrite only the regions affected by the changes of the polygons since the previous run on the same output folder", cmd, false);
+
+        TCLAP::SwitchArg profile_arg("", "profile", "Print a timing summary and write it to <output-las-folder>/profile.json", cmd, false);
+
         // Parse the argv array
         cmd.parse(argc, argv);
 
         polys_path = polys_arg.getValue();
+        mesh_path = mesh_arg.getValue();
 
         las_path = pc_arg.getValue();
         output_las_folder = o_pc_arg.getValue();
 
-    }
-    catch (TCLAP::ArgException &e) // catch exceptions
-    {
-        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
-        exit(-3);
-    }
+        profile = profile_arg.getValue();
 
-    // Read the polygons from the shapefile
-    SHPHandle hSHP;
-    // DBFHandle hDBF;
+        memory_budget = memory_arg.getValue();
 
-    // opening the input files
-    hSHP = SHPOpen(polys_path.c_str(), "rb");
-    // hDBF = DBFOpen(bound_name.c_str(), "rb");
+        if (shard_arg.isSet() && !URBAN3D::parse_shard(shard_arg.getValue(), shard))
+        {
+            std::cerr << "error: invalid shard " << shard_arg.getValue() << ", expected i/N with 0 <= i < N" << std::endl;
+            exit(-3);
+        }
 
-    int nShapeType, nRegions, nPoints, CodId, DescId;
-    double adfBndsMin[4], adfBndsMax[4];
+        n_launch = launch_arg.getValue();
+        n_merge  = merge_arg.getValue();
 
-    SHPObject ** regions;
-    std::list<int> * reg_points;
-    std::list<int> out_Points;
+        resume = resume_arg.getValue();
 
-    SHPGetInfo(hSHP, &nRegions, &nShapeType, adfBndsMin, adfBndsMax);
+        incremental = incremental_arg.getValue();
 
-    std::cout << "n regions: " << nRegions << std::endl;
+        append = append_arg.getValue();
 
-    if ((nShapeType != SHPT_POLYGONZ) && (nShapeType != SHPT_POLYGON))
-    {
-        // Wrong type: must be polygons
-        std::cerr << "Unsupported polygon type." << std::endl;
-        exit(1);
-    }
+        assignment.halo = halo_arg.getValue();
+        assignment.nearest = nearest_arg.getValue();
 
-    //std::cout << "ShapeType " << nShapeType << std::endl;
+        if (!URBAN3D::parse_overlap_policy(overlap_arg.getValue(), assignment.policy))
+        {
+            std::cerr << "error: invalid overlap policy " << overlap_arg.getValue() << std::endl;
+            exit(-3);
+        }
 
-    regions = new SHPObject * [nRegions];
-    reg_points = new std::list<int> [nRegions];
+        priority_field = priority_arg.getValue();
 
-     for (int i = 0; i < nRegions; ++i)
-    {
-        regions[i] = SHPReadObject(hSHP, i);
-    }
+        if (!URBAN3D::parse_strategy(strategy_arg.getValue(), assignment.strategy))
+        {
+            std::cerr << "error: invalid strategy " << strategy_arg.getValue() << std::endl;
+            exit(-3);
+        }
+
+        prism = prism_arg.getValue();
+
+        if (!prism.empty() && !mesh_path.empty())
+        {
+            std::cerr << "error: --prism needs polygons (-p)" << std::endl;
+            exit(-3);
+        }
+
+        if (filter_arg.isSet() && !filter.parse(filter_arg.getValue()))
+        {
+            std::cerr << "error: invalid filter " << filter_arg.getValue() << std::endl;
+            exit(-3);
+        }
 
-    // Check if the LAS file exists
-    std::ifstream ifs;
-    ifs.open(las_path.c_str(), std::ios::in | std::ios::binary);
+        // the cells of a tessellation do not overlap
+        if (!mesh_path.empty())
+            assignment.policy = URBAN3D::FIRST_REGION;
+
+        if (assignment.policy == URBAN3D::HIGHEST_PRIORITY && (priority_field.empty() || !mesh_path.empty()))
+        {
+            std::cerr << "error: --overlap priority needs polygons (-p) and --priority-field" << std::endl;
+            exit(-3);
+        }
+
+        if ((shard.sharded() || n_launch > 0) && memory_budget > 0)
+        {
+            std::cerr << "error: --shard and --launch cannot be combined with --memory-budget" << std::endl;
+            exit(-3);
+        }
+
+        if (incremental && (!mesh_path.empty() || shard.sharded() || n_launch > 0 || n_merge > 0))
+        {
+            std::cerr << "error: --incremental needs polygons (-p), and cannot be combined with --shard, --launch or --merge" << std::endl;
+            exit(-3);
+        }
 
-    if (ifs.is_open())
+        if (append && (incremental || memory_budget > 0 || shard.sharded() || n_launch > 0 || n_merge > 0))
+        {
+            std::cerr << "error: --append cannot be combined with --incremental, --memory-budget, --shard, --launch or --merge" << std::endl;
+            exit(-3);
+        }
+
+    }
+    catch (TCLAP::ArgException &e) // catch exceptions
     {
-        std::cout << "Processing LAS file: " << las_path << std::endl;
-        liblas::Reader reader(ifs);
-        liblas::Header const& header = reader.GetHeader();
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        exit(-3);
+    }
 
-        int nPoints = header.GetPointRecordsCount();
+    if (n_launch > 0)
+    {
+        // same command line, minus --launch, once per shard
+        std::string command;
 
-        std::cout << "Number of points in the LAS file: " << nPoints << std::endl;
+        for (int i=0; i < argc; i++)
+        {
+            std::string arg = argv[i];
 
-        // Store the points and the point-to-region mapping
-        std::vector<liblas::Point> Points;
-        std::vector<uint> point2region (nPoints, UINT_MAX);
+            if (arg == "--launch") { i++; continue; }
+            if (arg.rfind("--launch=", 0) == 0) continue;
+            if (arg == "--resume") continue;
 
-        std::vector<std::vector<uint>> region2point (nRegions, std::vector<uint>());
-        Points.reserve(nPoints);
+            command += (i > 0 ? " " : "") + URBAN3D::shell_quote(arg);
+        }
 
-        while (reader.ReadNextPoint())
+        bool ok;
         {
-            liblas::Point p = reader.GetPoint();  // safer than using a const ref
-            Points.push_back(p);
+            URBAN3D::PhaseTimer timer("shards");
+            ok = URBAN3D::run_local_shards(command, output_las_folder, n_launch, resume);
         }
 
-        std::atomic<int> lastPercentagePrinted{0};
+        n_merge = ok ? n_launch : 0;
+
+        if (!ok)
+            exit(1);
+    }
+
+    if (n_merge > 0)
+    {
+        URBAN3D::PhaseTimer timer("merge");
+
+        // the merged outputs are not recorded for --incremental
+        fs::remove(URBAN3D::layer_manifest_path(output_las_folder));
+
+        if (!URBAN3D::merge_shards(output_las_folder, n_merge))
+            exit(1);
+    }
+    else
+    {
+        if (resume && memory_budget == 0)
+            std::cerr << "Warning: --resume has no effect without --memory-budget or --launch" << std::endl;
+
+        URBAN3D::PolygonSet polys;
+        cinolib::Polygonmesh<> mesh;
 
-        #pragma omp parallel for ordered schedule(static,1)
-        for (int j = 0; j < nPoints; j++)
         {
-            // if (!point_in_polygon(external_boundary, cinolib::vec3d(Points.at(j).GetX(), Points.at(j).GetY(),Points.at(j).GetZ()), 0))
-            //     continue;
-            // reader.ReadNextPoint();
-            // const liblas::Point p = reader.GetPoint();
-            // Points.push_back(p);
+            URBAN3D::PhaseTimer timer("polygon load");
 
-            // std::cout << "Processing point " << j << " with coordinates: "
-            //           << Points.at(j).GetX() << ", "
-            //           << Points.at(j).GetY() << ", "
-            //           << Points.at(j).GetZ() << std::endl;
+            if (!mesh_path.empty())
+            {
+                // Read the regions from the cells of the polygon mesh
+                mesh = cinolib::Polygonmesh<>(mesh_path.c_str());
+                URBAN3D::load_polygons(mesh, polys);
+            }
+            else if (!URBAN3D::load_shapefile(polys_path, polys))
+            {
+                exit(1);
+            }
 
-            for (uint pid=0; pid < nRegions; pid++)
+            std::cout << "n regions: " << polys.num_polygons() << std::endl;
+
+            if (!prism.empty())
             {
-                if (pnpoly(regions[pid], Points[j].GetX(), Points[j].GetY()))
+                std::vector<double> zmin, zmax;
+
+                if (!URBAN3D::load_shapefile_z_bounds(polys_path, prism, zmin, zmax))
+                    exit(1);
+
+                if (zmin.size() != polys.num_polygons())
                 {
-                    // region2point.at(pid).push_back(j);
-                    point2region.at(j) = pid;
-                    // std::cout << "Point " << j << " belongs to region " << pid << std::endl;
-                    break;
+                    std::cerr << "The prism bounds are " << zmin.size() << " for " << polys.num_polygons() << " polygons." << std::endl;
+                    exit(1);
                 }
-            }
 
-            int currentPercentage = static_cast<int>((100.0 * j) / nPoints);
+                polys.set_z_bounds(zmin, zmax);
+            }
 
-            // Only one thread at a time checks & updates this
-            if (j==0 || currentPercentage > lastPercentagePrinted+4) // Update every 5%)
+            if (assignment.policy == URBAN3D::HIGHEST_PRIORITY)
             {
-                // atomic compare-and-swap: only one thread will succeed
-                int expected = lastPercentagePrinted;
-                if (lastPercentagePrinted.compare_exchange_strong(expected, currentPercentage))
+                if (!URBAN3D::load_shapefile_field(polys_path, priority_field, assignment.priorities))
+                    exit(1);
+
+                if (assignment.priorities.size() != polys.num_polygons())
                 {
-                    #pragma omp ordered
-                    {
-                        std::stringstream ss;
-                        ss << "Processed " << j << " points / " << nPoints
-                           << " total points (" << currentPercentage << "%)";
-
-                        if (currentPercentage == 100)
-                            ss << " - done!";
-                        else
-                            ss << "...";
-
-                        std::cout << ss.str() << std::endl;
-                    }
+                    std::cerr << "The attribute table has " << assignment.priorities.size() << " records for "
+                              << polys.num_polygons() << " polygons." << std::endl;
+                    exit(1);
                 }
             }
         }
 
-        for (int j = 0; j < nPoints; j++)
+        // record of the layer (for --incremental), written once the outputs are complete
+        URBAN3D::LayerManifest layer;
+        // (appended outputs come from several clouds: they have no record)
+        const bool record_layer = mesh_path.empty() && !shard.sharded() && !append;
+
+        if (record_layer)
+            layer.set_run(polys, las_path, assignment, filter);
+
+        URBAN3D::LayerManifest previous_layer;
+        bool update = false;
+
+        if (incremental)
         {
-            if (point2region.at(j) < UINT_MAX)
-                region2point.at(point2region.at(j)).push_back(j);
+            if (!previous_layer.read(URBAN3D::layer_manifest_path(output_las_folder)))
+                std::cout << "No record of a previous run found, partitioning from scratch" << std::endl;
+            else if (!previous_layer.same_run(layer))
+                std::cout << "The previous run had a different input or parameters, partitioning from scratch" << std::endl;
+            else
+                update = true;
         }
 
-        ///
-        for (uint pid=0; pid < nRegions; pid++)
+        // the outputs are about to change: until they are complete, they match no record
+        if (!update && !shard.sharded())
+            fs::remove(URBAN3D::layer_manifest_path(output_las_folder));
+
+        if (update)
         {
-            if (region2point.at(pid).size() == 0)
-            {
-                std::cout << "Region " << pid << " has no points." << std::endl;
-                continue;
-            }
+            URBAN3D::PhaseTimer timer("incremental partition");
 
-            std::ofstream outFile;
+            std::cout << "Processing LAS file: " << las_path << std::endl;
 
-            std::string outFolder = output_las_folder + "/building" + std::to_string(pid);
-            std::string outName = outFolder + "/" + std::to_string(pid) + ".las";
+            if (!URBAN3D::partition_LAS_incremental(polys, previous_layer, layer, las_path, output_las_folder, assignment, filter, true))
+                exit(1);
+        }
+        else if (memory_budget > 0)
+        {
+            URBAN3D::PhaseTimer timer("tiled partition");
 
-            // create output directory if it does not exist
-            if (!fs::exists(outFolder))
-            {
-                fs::create_directories(outFolder);
-            }
+            std::cout << "Processing LAS file: " << las_path << std::endl;
+
+            if (!URBAN3D::partition_LAS_tiled(polys, las_path, output_las_folder, memory_budget * 1024 * 1024, assignment, filter, true, resume))
+                exit(1);
+        }
+        else
+        {
+            liblas::Header header;
+            std::vector<liblas::Point> points;
+            std::vector<double> xs, ys, zs;   // zs only for prisms
 
-            if (!fs::exists(outFolder))
             {
-                std::cerr << "Error creating output directory: " << outFolder << std::endl;
-                continue;
+                URBAN3D::PhaseTimer timer("las read");
+
+                std::cout << "Processing LAS file: " << las_path << std::endl;
+
+                size_t begin = 0, end = SIZE_MAX;
+
+                if (shard.sharded())
+                {
+                    size_t nPoints = URBAN3D::count_LAS_points(las_path);
+
+                    begin = shard.begin(nPoints);
+                    end   = shard.end(nPoints);
+
+                    std::cout << "Shard " << shard.index << "/" << shard.count << ": points " << begin << " to " << end << std::endl;
+                }
+
+                if (!URBAN3D::read_LAS(las_path, header, points, xs, ys, begin, end, filter))
+                    exit(1);
+
+                if (polys.has_z_bounds())
+                {
+                    zs.resize(points.size());
+
+                    #pragma omp parallel for schedule(static)
+                    for (int64_t j = 0; j < int64_t(points.size()); j++)
+                        zs[j] = points[j].GetZ();
+                }
             }
 
-            std::cout << "Writing LAS file: " << outName << std::endl;
+            std::vector<uint> point2region (points.size(), UINT_MAX);
+            URBAN3D::PointRegions point_regions;
 
-            outFile.open(outName, std::ios::out | std::ios::binary);
-            if (!outFile.is_open())
             {
-                std::cerr << "Error opening output LAS file: " << outName << std::endl;
-                continue;
-                // exit(1);
+                URBAN3D::PhaseTimer timer("classify");
+
+                URBAN3D::SegmentGrid edges;
+
+                if (assignment.uses_edges())
+                    edges.build(polys);
+
+                if (!mesh_path.empty())
+                {
+                    // the cells of a tessellation do not overlap: no policy to apply
+                    URBAN3D::MeshLocator locator(mesh);
+                    URBAN3D::classify(locator, xs.data(), ys.data(), xs.size(), point2region.data(), true);
+
+                    if (assignment.halo > 0.0)
+                        URBAN3D::assign_halo(polys, edges, xs.data(), ys.data(), nullptr, xs.size(), point2region.data(), assignment.halo, point_regions);
+
+                    if (assignment.nearest > 0.0 && assignment.multi())
+                        URBAN3D::assign_nearest(edges, xs.data(), ys.data(), nullptr, xs.size(), assignment.nearest, point_regions);
+                    else if (assignment.nearest > 0.0)
+                        URBAN3D::assign_nearest(edges, xs.data(), ys.data(), nullptr, xs.size(), assignment.nearest, point2region.data());
+                }
+                else
+                {
+                    URBAN3D::assign_regions(polys, assignment, edges, xs.data(), ys.data(), zs.empty() ? nullptr : zs.data(), xs.size(),
+                                            point2region.data(), point_regions, true);
+                }
+
+                if (assignment.multi())
+                    std::cout << point_regions.regions.size() << " assignments for " << xs.size() << " points" << std::endl;
             }
 
-            liblas::Header h = header;
-            h.SetPointRecordsCount(region2point.at(pid).size());
-            liblas::Writer *writer = new liblas::Writer(outFile, h);
+            URBAN3D::RegionPoints region2point;
 
-            for (uint i=0; i < region2point.at(pid).size(); i++)
             {
-                writer->WritePoint(Points.at(region2point.at(pid).at(i)));
+                URBAN3D::PhaseTimer timer("regroup");
+
+                if (assignment.multi())
+                    region2point = URBAN3D::group_by_region(point_regions, polys.num_polygons());
+                else
+                    region2point = URBAN3D::group_by_region(point2region, polys.num_polygons());
             }
 
-            outFile.close();
+            {
+                URBAN3D::PhaseTimer timer("write");
+
+                bool ok;
+
+                if (shard.sharded())
+                {
+                    // start from an empty folder: a failed run may have left partial outputs
+                    std::string folder = URBAN3D::shard_folder(output_las_folder, shard.index);
+                    fs::remove_all(folder);
+
+                    ok = URBAN3D::write_region_LAS(folder, header, points, region2point.offsets, region2point.points, region2point.n_chunks);
+                }
+                else
+                {
+                    ok = URBAN3D::write_region_LAS(output_las_folder, header, points, region2point.offsets, region2point.points, region2point.n_chunks, append);
+                }
+
+                // keep the points outside every region
+                if (ok && assignment.nearest > 0.0)
+                {
+                    std::string folder = shard.sharded() ? URBAN3D::shard_folder(output_las_folder, shard.index) : output_las_folder;
+                    URBAN3D::RegionPoints unassigned = assignment.multi() ? URBAN3D::unassigned_points(point_regions)
+                                                                          : URBAN3D::unassigned_points(point2region);
+
+                    ok = append ? URBAN3D::append_LAS(folder + "/unassigned.las", header, points, unassigned.of(0))
+                                : URBAN3D::write_LAS(folder + "/unassigned.las", header, points, unassigned.of(0));
+                }
+
+                // incomplete outputs are neither marked done (for a shard: --resume runs it again,
+                // and merging fails) nor recorded for --incremental
+                if (!ok)
+                    exit(1);
+
+                if (shard.sharded() && !URBAN3D::mark_shard_done(output_las_folder, shard.index))
+                {
+                    std::cerr << "Error marking shard " << shard.index << " as done" << std::endl;
+                    exit(1);
+                }
+            }
         }
 
-        ifs.close();
+        if (record_layer && !layer.write(URBAN3D::layer_manifest_path(output_las_folder)))
+            exit(1);
+    }
+
+    if (profile)
+    {
+        URBAN3D::Profiler::instance().print_summary(std::cout);
+
+        fs::create_directories(output_las_folder);
+        std::string profile_name = shard.sharded() ? "/profile_shard" + std::to_string(shard.index) + ".json" : "/profile.json";
+        URBAN3D::Profiler::instance().write_json(output_las_folder + profile_name);
     }
 
 
@@ -1,12 +1,25 @@
 #ifndef CITY_AUXILIARY
 #define CITY_AUXILIARY
 
+#include "../io/gis_geometry.h"
+#include "../utils/profiler.h"
+
 #include <cinolib/meshes/meshes.h>
 #include <shapefil.h>
 
 inline
 int pnpoly(SHPObject * region, double testx, double testy)
 {
+    PIP_COUNT(PNPOLY_CALLS, 1);
+
+    // early exit on the bounding box, before touching the vertices
+    if (testx < region->dfXMin || testy < region->dfYMin ||
+        testx > region->dfXMax || testy > region->dfYMax )
+    {
+        PIP_COUNT(BBOX_REJECTIONS, 1);
+        return 0;
+    }
+
     int nvert = region->nVertices;
     double *vertx = region->padfX;
     double *verty = region->padfY;
@@ -16,26 +29,50 @@ int pnpoly(SHPObject * region, double testx, double testy)
         nvert = region->panPartStart[1];
     }
 
+    PIP_COUNT(EDGES_TESTED, nvert);
+
     int i, j, c = 0;
 
     for (i = 0, j = nvert - 1; i < nvert; j = i++) {
 
-        bool bbout = false;
-
-        if (testx < region->dfXMin || testy < region->dfYMin ||
-            testx > region->dfXMax || testy > region->dfYMax )
-            bbout = true;
-
-        if (!bbout && ((verty[i] > testy) != (verty[j] > testy)) &&
+        if (((verty[i] > testy) != (verty[j] > testy)) &&
             (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
             c = !c;
     }
 
-#ifdef _DEEPTIMING_
-    pnp_time += hmt_get (&pnp);
-#endif
     return c;
 }
 
+// Crossing test against one feature of a flat geometry buffer, reading the
+// coordinates in place. All the rings of all the parts are walked, so holes
+// and multipart polygons follow the even-odd rule.
+inline
+int pnpoly(const GISGeometryBuffer &polys, const size_t fid, double testx, double testy)
+{
+    PIP_COUNT(PNPOLY_CALLS, 1);
+
+    int c = 0;
+
+    uint64_t ring_begin = polys.part_ring_begin(polys.feature_part_begin(fid));
+    uint64_t ring_end   = polys.part_ring_begin(polys.feature_part_end(fid));
+
+    for (uint64_t r = ring_begin; r < ring_end; r++)
+    {
+        GISSpan<const cinolib::vec3d> ring = polys.ring(r);
+
+        size_t nvert = ring.size();
+
+        PIP_COUNT(EDGES_TESTED, nvert);
+
+        for (size_t i = 0, j = nvert - 1; i < nvert; j = i++) {
+
+            if (((ring[i].y() > testy) != (ring[j].y() > testy)) &&
+                (testx < (ring[j].x() - ring[i].x()) * (testy - ring[i].y()) / (ring[j].y() - ring[i].y()) + ring[i].x()))
+                c = !c;
+        }
+    }
+
+    return c;
+}
 
 #endif // CITY_AUXILIARY
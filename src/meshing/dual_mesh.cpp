@@ -10,19 +10,36 @@
 
 #include <cinolib/export_mesh_from_clusters.h>
 
+#include <queue>
+#include <unordered_set>
+
 namespace URBAN3D
 {
 
-inline
+PIP_INLINE
+uint64_t dual_edge_key(uint v0, uint v1)
+{
+    if (v0 > v1) std::swap(v0, v1);
+    return (static_cast<uint64_t>(v0) << 32) | v1;
+}
+
+PIP_INLINE
 void dual_mesh(const cinolib::Trimesh<> &m, cinolib::Polygonmesh<> &dual_m)
 {
-    std::vector<cinolib::vec3d>    dual_verts;
-    std::vector<std::vector<uint>> dual_polys;
+    // dual vertices (triangle centroids, then shared edge midpoints) and dual segments,
+    // collected in plain arrays: the constraints only need to be looked up, not navigated
+    std::vector<cinolib::vec3d> dual_verts;
+    std::vector<uint>           dual_segs;
+    std::unordered_set<uint64_t> dual_edges;
 
     cinolib::Trimesh<> dual_tri;
 
+    dual_verts.reserve(m.num_polys() + m.num_edges());
+    dual_segs.reserve(4 * m.num_edges());
+    dual_edges.reserve(2 * m.num_edges());
+
     for (uint pid=0; pid < m.num_polys(); pid++)
-        dual_m.vert_add(m.poly_centroid(pid));
+        dual_verts.push_back(m.poly_centroid(pid));
 
     for (uint pid=0; pid < m.num_polys(); pid++)
         for (uint adj : m.adj_p2p(pid))
@@ -31,37 +48,34 @@ void dual_mesh(const cinolib::Trimesh<> &m, cinolib::Polygonmesh<> &dual_m)
             {
                 uint shared_eid = m.edge_shared(pid, adj);
 
-                int vid = dual_m.vert_add(URBAN3D::edge_center(m.edge_vert(shared_eid, 0), m.edge_vert(shared_eid, 1)));
+                uint vid = dual_verts.size();
+                dual_verts.push_back(URBAN3D::edge_center(m.edge_vert(shared_eid, 0), m.edge_vert(shared_eid, 1)));
 
-                int eid = dual_m.edge_add(pid, vid);
-                dual_m.edge_data(eid).flags[cinolib::MARKED] = true;
+                dual_segs.push_back(pid);
+                dual_segs.push_back(vid);
+                dual_edges.insert(dual_edge_key(pid, vid));
 
-                eid = dual_m.edge_add(adj, vid);
-                dual_m.edge_data(eid).flags[cinolib::MARKED] = true;
+                dual_segs.push_back(adj);
+                dual_segs.push_back(vid);
+                dual_edges.insert(dual_edge_key(adj, vid));
             }
         }
 
-    std::cout << dual_m.num_verts() << " \\ " << dual_m.num_edges() << " \\ " << dual_m.num_polys() << std::endl;
+    std::cout << dual_verts.size() << " \\ " << dual_segs.size()/2 << std::endl;
 
-    cinolib::triangle_wrap(dual_m.vector_verts(), dual_m.vector_edges(), std::vector<cinolib::vec3d>(), 0.0, "", dual_tri);
+    cinolib::triangle_wrap(dual_verts, dual_segs, std::vector<cinolib::vec3d>(), 0.0, "", dual_tri);
 
     for (uint eid=0; eid < dual_tri.num_edges(); eid++)
     {
         uint vid0=dual_tri.edge_vert_id(eid,0);
         uint vid1=dual_tri.edge_vert_id(eid,1);
 
-        bool exists = false;
-
-        for (uint e : dual_m.adj_v2e(vid0))
-            if (dual_m.edge_contains_vert(e, vid1))
-            {
-                exists=true;
-                dual_tri.edge_data(eid).flags[cinolib::MARKED] = true;
-                break;
-            }
+        if (dual_edges.count(dual_edge_key(vid0, vid1)) > 0)
+            dual_tri.edge_data(eid).flags[cinolib::MARKED] = true;
     }
 
-    std::vector<std::vector<uint>> polys;
+    // flood fill the triangles into clusters bounded by the dual edges
+    int n_clusters = 0;
 
     for (uint pid=0; pid < dual_tri.num_polys(); pid++)
     {
@@ -70,37 +84,38 @@ void dual_mesh(const cinolib::Trimesh<> &m, cinolib::Polygonmesh<> &dual_m)
         std::queue<uint> pids;
         pids.push(pid);
 
-        std::vector<uint> poly;
-        poly.push_back(pid);
-        dual_tri.poly_data(pid).label = polys.size();
+        dual_tri.poly_data(pid).label = n_clusters;
 
         while (!pids.empty())
         {
             uint curr_pid = pids.front();
             pids.pop();
 
-            for (uint adj_pid : dual_tri.adj_p2p(curr_pid))
+            for (uint eid : dual_tri.adj_p2e(curr_pid))
             {
-                if (dual_tri.edge_data(dual_tri.edge_shared(curr_pid, adj_pid)).flags[cinolib::MARKED] == true)
+                if (dual_tri.edge_data(eid).flags[cinolib::MARKED] == true)
                     continue;
 
-                if (dual_tri.poly_data(adj_pid).label > -1)
-                    continue;
+                for (uint adj_pid : dual_tri.adj_e2p(eid))
+                {
+                    if (dual_tri.poly_data(adj_pid).label > -1)
+                        continue;
 
-                poly.push_back(adj_pid);
-                dual_tri.poly_data(adj_pid).label = polys.size();
+                    dual_tri.poly_data(adj_pid).label = n_clusters;
 
-                pids.push(adj_pid);
+                    pids.push(adj_pid);
+                }
             }
         }
 
-        polys.push_back(poly);
+        n_clusters++;
     }
 
-    for (uint p=0; p < polys.size(); p++)
-    {
-        cinolib::export_mesh_from_clusters(dual_tri, dual_m);
-    }
+    std::cout << n_clusters << " dual polygons" << std::endl;
+
+    // one pass over the labeled triangulation exports all the clusters at once
+    dual_m.clear();
+    cinolib::export_mesh_from_clusters(dual_tri, dual_m);
 }
 
 }
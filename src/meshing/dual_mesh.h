@@ -8,6 +8,7 @@
 #ifndef DUAL_MESH_H
 #define DUAL_MESH_H
 
+#include "../utils/pip_inline.h"
 #include <cinolib/meshes/meshes.h>
 #include <cinolib/triangle_wrap.h>
 
@@ -0,0 +1,833 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "classifier.h"
+#include "point_grid.h"
+#include "../utils/profiler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+
+namespace URBAN3D
+{
+
+// points per progress report
+const size_t CLASSIFY_CHUNK = 1 << 20;
+
+PIP_INLINE
+void print_progress (const size_t done, const size_t n)
+{
+    int percentage = static_cast<int>((100.0 * done) / std::max(n, size_t(1)));
+
+    std::cout << "Processed " << done << " points / " << n
+              << " total points (" << percentage << "%)"
+              << (done == n ? " - done!" : "...") << std::endl;
+}
+
+// One ContainsTally per OpenMP thread, for the point-by-point classifiers: each thread
+// counts in its own, and the sum goes to the Profiler once the points are classified
+class ThreadTallies
+{
+private:
+
+    std::vector<ContainsTally> tallies;
+
+public:
+
+    ThreadTallies () : tallies(omp_get_max_threads()) {}
+
+    ContainsTally & local () { return tallies[omp_get_thread_num()]; }
+
+    void report () const
+    {
+        uint64_t accepted = 0, tested = 0;
+
+        for (const ContainsTally &t : tallies)
+        {
+            accepted += t.quick_accepts;
+            tested   += t.crossing_tests;
+        }
+
+        Profiler::instance().add_quick_accepts(accepted, tested);
+    }
+};
+
+PIP_INLINE
+bool parse_overlap_policy (const std::string &s, OverlapPolicy &policy)
+{
+    if      (s == "first")    policy = FIRST_REGION;
+    else if (s == "all")      policy = ALL_REGIONS;
+    else if (s == "smallest") policy = SMALLEST_AREA;
+    else if (s == "priority") policy = HIGHEST_PRIORITY;
+    else return false;
+
+    return true;
+}
+
+PIP_INLINE
+bool parse_strategy (const std::string &s, ClassifyStrategy &strategy)
+{
+    if      (s == "auto")     strategy = AUTO_STRATEGY;
+    else if (s == "points")   strategy = POINT_DRIVEN;
+    else if (s == "polygons") strategy = POLYGON_DRIVEN;
+    else return false;
+
+    return true;
+}
+
+PIP_INLINE
+void classify (const PolygonSet &polys, const double *x, const double *y, const size_t n,
+               uint *point2region, const bool verbose)
+{
+    ThreadTallies tallies;
+
+    for (size_t begin=0; begin < n; begin += CLASSIFY_CHUNK)
+    {
+        int64_t end = std::min(begin + CLASSIFY_CHUNK, n);
+
+        #pragma omp parallel for schedule(static)
+        for (int64_t j = begin; j < end; j++)
+            point2region[j] = polys.locate(x[j], y[j], tallies.local());
+
+        if (verbose)
+            print_progress(end, n);
+    }
+
+    tallies.report();
+}
+
+// classify_batch() on at most POINT_CHUNK points, so that point indices fit 32 bits
+PIP_INLINE
+void classify_batch_chunk (const PolygonSet &polys, const double *x, const double *y, const double *z, const size_t n,
+                           uint *point2region)
+{
+    const RegionGrid &grid = polys.get_grid();
+    const bool prism = z != nullptr && polys.has_z_bounds();
+
+    const size_t n_cells = size_t(grid.num_cells_x()) * grid.num_cells_y();
+
+    // bucket the points by cell (counting sort); points outside the grid go to bucket n_cells
+    std::vector<uint>     point_cell (n);
+    std::vector<uint64_t> cell_offsets (n_cells + 2, 0);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t j = 0; j < (int64_t) n; j++)
+    {
+        uint cx, cy;
+        point_cell[j] = grid.cell_of(x[j], y[j], cx, cy) ? uint(size_t(cy) * grid.num_cells_x() + cx) : uint(n_cells);
+        point2region[j] = UINT_MAX;
+    }
+
+    for (size_t j = 0; j < n; j++)
+        cell_offsets[point_cell[j] + 1]++;
+
+    for (size_t c = 1; c < cell_offsets.size(); c++)
+        cell_offsets[c] += cell_offsets[c-1];
+
+    std::vector<uint> cell_points (n);
+    {
+        std::vector<uint64_t> fill (cell_offsets.begin(), cell_offsets.end()-1);
+
+        for (size_t j = 0; j < n; j++)
+            cell_points[fill[point_cell[j]]++] = j;
+    }
+
+    std::vector<uint>().swap(point_cell);
+
+    #pragma omp parallel
+    {
+        // per-thread scratch: points of the cell still unassigned, and those passing the bbox test
+        std::vector<uint>     pending, tested;
+        std::vector<double>   px, py;
+        std::vector<uint8_t>  inside;
+
+        uint64_t n_quick = 0, n_crossing = 0;
+
+        #pragma omp for schedule(dynamic, 16)
+        for (int64_t c = 0; c < (int64_t) n_cells; c++)
+        {
+            if (cell_offsets[c] == cell_offsets[c+1])
+                continue;
+
+            GISSpan<const uint> candidates = grid.cell_candidates(uint(c % grid.num_cells_x()), uint(c / grid.num_cells_x()));
+
+            PIP_COUNT(INDEX_CANDIDATES, candidates.size() * (cell_offsets[c+1] - cell_offsets[c]));
+
+            pending.assign(cell_points.begin() + cell_offsets[c], cell_points.begin() + cell_offsets[c+1]);
+
+            for (uint pid : candidates)
+            {
+                if (pending.empty())
+                    break;
+
+                const BBox2 &b = polys.bbox(pid);
+
+                tested.clear();
+                px.clear();
+                py.clear();
+
+                size_t n_accepted = 0;
+
+                for (uint j : pending)
+                {
+                    // Z interval first: it rejects vegetation and other roofs cheaply
+                    if ((!prism || polys.in_z_range(pid, z[j])) && b.contains(x[j], y[j]))
+                    {
+                        if (polys.quick_accept(pid, x[j], y[j]))
+                        {
+                            point2region[j] = pid;
+                            n_accepted++;
+                            continue;
+                        }
+
+                        tested.push_back(j);
+                        px.push_back(x[j]);
+                        py.push_back(y[j]);
+                    }
+                }
+
+                PIP_COUNT(BBOX_REJECTIONS, pending.size() - tested.size() - n_accepted);
+                PIP_COUNT(QUICK_ACCEPTS, n_accepted);
+
+                n_quick    += n_accepted;
+                n_crossing += tested.size();
+
+                bool any = n_accepted > 0;
+
+                inside.resize(tested.size());
+
+                if (!tested.empty())
+                    polys.contains(pid, px.data(), py.data(), tested.size(), inside.data());
+
+                for (size_t k = 0; k < tested.size(); k++)
+                {
+                    if (inside[k])
+                    {
+                        point2region[tested[k]] = pid;
+                        any = true;
+                    }
+                }
+
+                // drop the points just assigned, keeping the order
+                if (any)
+                    pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                                 [&](const uint j) { return point2region[j] != UINT_MAX; }),
+                                  pending.end());
+            }
+        }
+
+        Profiler::instance().add_quick_accepts(n_quick, n_crossing);
+    }
+}
+
+PIP_INLINE
+void classify_batch (const PolygonSet &polys, const double *x, const double *y, const double *z, const size_t n,
+                     uint *point2region, const bool verbose)
+{
+    for (size_t begin = 0; begin < n; begin += POINT_CHUNK)
+    {
+        const size_t end = std::min(n, size_t(begin + POINT_CHUNK));
+
+        classify_batch_chunk(polys, x + begin, y + begin, z ? z + begin : nullptr, end - begin, point2region + begin);
+
+        if (verbose && end < n)
+            print_progress(end, n);
+    }
+
+    if (verbose)
+        print_progress(n, n);
+}
+
+PIP_INLINE
+void classify_ranked (const PolygonSet &polys, const std::vector<double> &rank,
+                      const double *x, const double *y, const double *z, const size_t n, uint *point2region)
+{
+    const bool prism = z != nullptr && polys.has_z_bounds();
+
+    ThreadTallies tallies;
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t j = 0; j < (int64_t) n; j++)
+    {
+        uint best = UINT_MAX;
+
+        GISSpan<const uint> candidates = polys.get_grid().candidates(x[j], y[j]);
+
+        PIP_COUNT(INDEX_CANDIDATES, candidates.size());
+
+        for (uint pid : candidates)
+        {
+            if (best != UINT_MAX && rank[pid] >= rank[best])
+                continue;
+
+            if (prism && !polys.in_z_range(pid, z[j]))
+                continue;
+
+            if (polys.contains(pid, x[j], y[j], tallies.local()))
+                best = pid;
+        }
+
+        point2region[j] = best;
+    }
+
+    tallies.report();
+}
+
+// segment (x0,y0)-(x1,y1) meets box b: their bboxes overlap, and the corners of b
+// are not all strictly on the same side of the line
+PIP_INLINE
+bool segment_meets_box (const double x0, const double y0, const double x1, const double y1, const BBox2 &b)
+{
+    if (std::max(x0, x1) < b.xmin || std::min(x0, x1) > b.xmax || std::max(y0, y1) < b.ymin || std::min(y0, y1) > b.ymax)
+        return false;
+
+    const double dx = x1 - x0, dy = y1 - y0;
+
+    auto side = [&](const double x, const double y) { return dx * (y - y0) - dy * (x - x0); };
+
+    const double s0 = side(b.xmin, b.ymin), s1 = side(b.xmax, b.ymin);
+    const double s2 = side(b.xmin, b.ymax), s3 = side(b.xmax, b.ymax);
+
+    return !((s0 > 0 && s1 > 0 && s2 > 0 && s3 > 0) || (s0 < 0 && s1 < 0 && s2 < 0 && s3 < 0));
+}
+
+// classify_by_polygon() on at most POINT_CHUNK points, so that point indices fit 32 bits
+PIP_INLINE
+void classify_by_polygon_chunk (const PolygonSet &polys, const std::vector<uint> &order,
+                                const double *x, const double *y, const double *z, const size_t n,
+                                uint *point2region)
+{
+    const bool prism = z != nullptr && polys.has_z_bounds();
+
+    std::fill(point2region, point2region + n, UINT_MAX);
+
+    PointGrid grid;
+    grid.build(x, y, n);
+
+    // cell boxes are grown a little when tested against the edges: a point may fall in
+    // a cell whose computed box misses it by a rounding error
+    const double tol = 1e-6 * std::max(grid.get_cell_w(), grid.get_cell_h());
+
+    std::vector<uint8_t> boundary;   // cells of the bbox window crossed by an edge
+
+    uint64_t n_quick = 0, n_crossing = 0;
+
+    for (uint pid : order)
+    {
+        uint wx0, wy0, wx1, wy1;
+
+        if (!grid.cell_range(polys.bbox(pid), wx0, wy0, wx1, wy1))
+            continue;
+
+        const size_t wx = wx1 - wx0 + 1;
+        const size_t wy = wy1 - wy0 + 1;
+
+        boundary.assign(wx * wy, 0);
+
+        const double *xs = polys.get_xs();
+        const double *ys = polys.get_ys();
+
+        for (uint64_t r = polys.poly_ring_begin(pid); r < polys.poly_ring_end(pid); r++)
+        {
+            const uint64_t begin = polys.ring_vert_begin(r);
+            const uint64_t end   = polys.ring_vert_end(r);
+
+            for (uint64_t i = begin, j = end - 1; i < end; j = i++)
+            {
+                BBox2 e;
+                e.add(xs[i], ys[i]);
+                e.add(xs[j], ys[j]);
+                e.xmin -= tol; e.ymin -= tol;
+                e.xmax += tol; e.ymax += tol;
+
+                uint cx0, cy0, cx1, cy1;
+
+                if (!grid.cell_range(e, cx0, cy0, cx1, cy1))
+                    continue;
+
+                for (uint cy = std::max(cy0, wy0); cy <= std::min(cy1, wy1); cy++)
+                {
+                    for (uint cx = std::max(cx0, wx0); cx <= std::min(cx1, wx1); cx++)
+                    {
+                        uint8_t &cell = boundary[(cy - wy0) * wx + (cx - wx0)];
+
+                        if (cell) continue;
+
+                        BBox2 b = grid.cell_bbox(cx, cy);
+                        b.xmin -= tol; b.ymin -= tol;
+                        b.xmax += tol; b.ymax += tol;
+
+                        cell = segment_meets_box(xs[i], ys[i], xs[j], ys[j], b);
+                    }
+                }
+            }
+        }
+
+        const BBox2 &bbox = polys.bbox(pid);
+
+        // small regions are not worth a parallel region
+        #pragma omp parallel if (wx * wy >= 256) reduction(+:n_quick, n_crossing)
+        {
+            // per-thread scratch: points of a boundary cell still unassigned and in the bbox
+            std::vector<uint>    tested;
+            std::vector<double>  px, py;
+            std::vector<uint8_t> inside;
+
+            #pragma omp for schedule(dynamic, 16)
+            for (int64_t k = 0; k < int64_t(wx * wy); k++)
+            {
+                const uint cx = wx0 + uint(k % wx);
+                const uint cy = wy0 + uint(k / wx);
+
+                GISSpan<const uint> points = grid.points(cx, cy);
+
+                if (points.empty())
+                    continue;
+
+                if (!boundary[k])
+                {
+                    // entirely inside or outside the region
+                    BBox2 b = grid.cell_bbox(cx, cy);
+
+                    if (!polys.contains(pid, 0.5 * (b.xmin + b.xmax), 0.5 * (b.ymin + b.ymax)))
+                        continue;
+
+                    size_t n_accepted = 0;
+
+                    for (uint j : points)
+                    {
+                        if (point2region[j] == UINT_MAX && (!prism || polys.in_z_range(pid, z[j])))
+                        {
+                            point2region[j] = pid;
+                            n_accepted++;
+                        }
+                    }
+
+                    PIP_COUNT(QUICK_ACCEPTS, n_accepted);
+                    n_quick += n_accepted;
+                    continue;
+                }
+
+                tested.clear();
+                px.clear();
+                py.clear();
+
+                for (uint j : points)
+                {
+                    if (point2region[j] == UINT_MAX && (!prism || polys.in_z_range(pid, z[j])) && bbox.contains(x[j], y[j]))
+                    {
+                        tested.push_back(j);
+                        px.push_back(x[j]);
+                        py.push_back(y[j]);
+                    }
+                }
+
+                PIP_COUNT(BBOX_REJECTIONS, points.size() - tested.size());
+
+                if (tested.empty())
+                    continue;
+
+                n_crossing += tested.size();
+
+                inside.resize(tested.size());
+                polys.contains(pid, px.data(), py.data(), tested.size(), inside.data());
+
+                for (size_t t = 0; t < tested.size(); t++)
+                    if (inside[t])
+                        point2region[tested[t]] = pid;
+            }
+        }
+    }
+
+    Profiler::instance().add_quick_accepts(n_quick, n_crossing);
+}
+
+PIP_INLINE
+void classify_by_polygon (const PolygonSet &polys, const std::vector<double> &rank,
+                          const double *x, const double *y, const double *z, const size_t n,
+                          uint *point2region, const bool verbose)
+{
+    // regions from the best ranked, ties by id
+    std::vector<uint> order (polys.num_polygons());
+
+    for (uint pid=0; pid < order.size(); pid++)
+        order[pid] = pid;
+
+    if (!rank.empty())
+        std::stable_sort(order.begin(), order.end(), [&](const uint a, const uint b) { return rank[a] < rank[b]; });
+
+    for (size_t begin = 0; begin < n; begin += POINT_CHUNK)
+    {
+        const size_t end = std::min(n, size_t(begin + POINT_CHUNK));
+
+        classify_by_polygon_chunk(polys, order, x + begin, y + begin, z ? z + begin : nullptr, end - begin, point2region + begin);
+
+        if (verbose && end < n)
+            print_progress(end, n);
+    }
+
+    if (verbose)
+        print_progress(n, n);
+}
+
+// Relative costs of the steps of the two strategies (about ns on a recent x86 core)
+const double COST_POINT_LOOKUP = 20.0;  // point-driven: bucketing a point and fetching its candidates
+const double COST_BBOX_TEST    = 2.0;   // point-driven: a point against the bbox of a candidate
+const double COST_EDGE_TEST    = 1.0;   // a point against an edge (batched crossing test)
+const double COST_POINT_BIN    = 10.0;  // polygon-driven: bucketing a point in the point grid
+const double COST_CELL_VISIT   = 5.0;   // polygon-driven: a cell under the bbox of a region
+const double COST_EDGE_RASTER  = 20.0;  // polygon-driven: finding the cells crossed by an edge
+const double COST_BULK_ACCEPT  = 1.0;   // polygon-driven: a point assigned with its cell
+
+PIP_INLINE
+StrategyCosts estimate_strategy_costs (const PolygonSet &polys, const double *x, const double *y, const size_t n)
+{
+    StrategyCosts costs;
+
+    BBox2 extent;
+    for (size_t j = 0; j < n; j++)
+        extent.add(x[j], y[j]);
+
+    if (extent.empty())
+        return costs;
+
+    const double area = std::max(extent.xmax - extent.xmin, 1e-9) * std::max(extent.ymax - extent.ymin, 1e-9);
+
+    // as in PointGrid::build()
+    const double points_per_cell = 32.0;
+    const double n_cells   = std::max(1.0, double(n) / points_per_cell);
+    const double cell_size = std::sqrt(area / n_cells);
+
+    auto overlap = [](const BBox2 &a, const BBox2 &b)
+    {
+        const double w = std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin);
+        const double h = std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin);
+        return (w > 0 && h > 0) ? w * h : 0.0;
+    };
+
+    costs.point_driven   = n * COST_POINT_LOOKUP;
+    costs.polygon_driven = n * COST_POINT_BIN;
+
+    const double *xs = polys.get_xs();
+    const double *ys = polys.get_ys();
+
+    for (uint pid=0; pid < polys.num_polygons(); pid++)
+    {
+        const BBox2 &b = polys.bbox(pid);
+        const double covered = overlap(b, extent);
+
+        if (covered <= 0.0)
+            continue;
+
+        double n_vertices = 0.0, perimeter = 0.0;
+
+        for (uint64_t r = polys.poly_ring_begin(pid); r < polys.poly_ring_end(pid); r++)
+        {
+            const uint64_t begin = polys.ring_vert_begin(r);
+            const uint64_t end   = polys.ring_vert_end(r);
+
+            n_vertices += double(end - begin);
+
+            for (uint64_t i = begin, j = end - 1; i < end; j = i++)
+                perimeter += std::hypot(xs[i] - xs[j], ys[i] - ys[j]);
+        }
+
+        double inner = 0.0;
+        for (const BBox2 &ib : polys.inner(pid))
+            inner += overlap(ib, extent);
+
+        const double in_bbox = n * covered / area;   // points in the bbox of the region
+
+        costs.point_driven += in_bbox * (COST_BBOX_TEST + std::max(0.0, 1.0 - inner / covered) * n_vertices * COST_EDGE_TEST);
+
+        const double bbox_cells     = covered / (cell_size * cell_size) + 1.0;
+        const double boundary_cells = std::min(bbox_cells, perimeter / cell_size + n_vertices);
+
+        costs.polygon_driven += bbox_cells * COST_CELL_VISIT + n_vertices * COST_EDGE_RASTER +
+                                boundary_cells * points_per_cell * n_vertices * COST_EDGE_TEST +
+                                in_bbox * COST_BULK_ACCEPT;
+    }
+
+    return costs;
+}
+
+PIP_INLINE
+void assign_all (const PolygonSet &polys, const double *x, const double *y, const double *z, const size_t n,
+                 PointRegions &pr)
+{
+    const bool prism = z != nullptr && polys.has_z_bounds();
+
+    ThreadTallies tallies;
+
+    build_point_regions(n, [&](const size_t j, std::vector<uint> &out)
+    {
+        GISSpan<const uint> candidates = polys.get_grid().candidates(x[j], y[j]);
+
+        PIP_COUNT(INDEX_CANDIDATES, candidates.size());
+
+        // candidates are sorted: so are the regions
+        for (uint pid : candidates)
+            if ((!prism || polys.in_z_range(pid, z[j])) && polys.contains(pid, x[j], y[j], tallies.local()))
+                out.push_back(pid);
+    }, pr);
+
+    tallies.report();
+}
+
+PIP_INLINE
+void classify (const PolygonSet &polys, const OverlapPolicy policy, const std::vector<double> &priorities,
+               const double *x, const double *y, const double *z, const size_t n,
+               uint *point2region, PointRegions &point_regions, const bool verbose)
+{
+    switch (policy)
+    {
+        case FIRST_REGION:
+            classify_batch(polys, x, y, z, n, point2region, verbose);
+            return;
+
+        case ALL_REGIONS:
+            std::fill(point2region, point2region + n, UINT_MAX);
+            assign_all(polys, x, y, z, n, point_regions);
+            break;
+
+        case SMALLEST_AREA:
+            classify_ranked(polys, polys.get_areas(), x, y, z, n, point2region);
+            break;
+
+        case HIGHEST_PRIORITY:
+        {
+            std::vector<double> rank (priorities.size());
+            for (size_t pid=0; pid < rank.size(); pid++)
+                rank[pid] = -priorities[pid];
+
+            classify_ranked(polys, rank, x, y, z, n, point2region);
+            break;
+        }
+    }
+
+    if (verbose)
+        print_progress(n, n);
+}
+
+PIP_INLINE
+void classify (const MeshLocator &locator, const double *x, const double *y, const size_t n,
+               uint *point2region, const bool verbose)
+{
+    size_t n_fallbacks = 0;
+
+    for (size_t begin=0; begin < n; begin += CLASSIFY_CHUNK)
+    {
+        int64_t end = std::min(begin + CLASSIFY_CHUNK, n);
+
+        #pragma omp parallel reduction(+:n_fallbacks)
+        {
+            int hint = -1;
+
+            #pragma omp for schedule(static)
+            for (int64_t j = begin; j < end; j++)
+            {
+                bool walked;
+                int pid = locator.locate(x[j], y[j], hint, walked);
+
+                if (!walked)
+                    n_fallbacks++;
+
+                point2region[j] = (pid >= 0) ? uint(pid) : UINT_MAX;
+
+                if (pid >= 0)
+                    hint = pid;
+            }
+        }
+
+        if (verbose)
+            print_progress(end, n);
+    }
+
+    if (verbose)
+        std::cout << "Mesh walk - " << n_fallbacks << " / " << n << " points located through the index" << std::endl;
+}
+
+PIP_INLINE
+void assign_halo (const PolygonSet &polys, const SegmentGrid &edges, const double *x, const double *y, const double *z,
+                  const size_t n, const uint *point2region, const double d, PointRegions &pr)
+{
+    const bool prism = z != nullptr && polys.has_z_bounds();
+
+    ThreadTallies tallies;
+
+    build_point_regions(n, [&](const size_t j, std::vector<uint> &out)
+    {
+        edges.polygons_within(x[j], y[j], d, out, prism ? z[j] : NAN);
+
+        size_t n_near = out.size();
+
+        if (point2region[j] < UINT_MAX)
+            out.push_back(point2region[j]);
+
+        for (uint pid : polys.get_grid().candidates(x[j], y[j]))
+            if (pid != point2region[j] && (!prism || polys.in_z_range(pid, z[j])) && polys.contains(pid, x[j], y[j], tallies.local()))
+                out.push_back(pid);
+
+        if (out.size() > n_near)
+        {
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+    }, pr);
+
+    tallies.report();
+}
+
+PIP_INLINE
+void assign_regions (const PolygonSet &polys, const AssignmentOptions &opts, const SegmentGrid &edges,
+                     const double *x, const double *y, const double *z, const size_t n,
+                     uint *point2region, PointRegions &point_regions, const bool verbose)
+{
+    // with a halo, the owner is the first containing region
+    const OverlapPolicy policy = opts.halo > 0.0 ? FIRST_REGION : opts.policy;
+
+    ClassifyStrategy strategy = policy == ALL_REGIONS ? POINT_DRIVEN : opts.strategy;
+
+    if (strategy == AUTO_STRATEGY)
+    {
+        StrategyCosts costs = estimate_strategy_costs(polys, x, y, n);
+        strategy = costs.best();
+
+        if (verbose)
+            std::cout << "Strategy: " << (strategy == POLYGON_DRIVEN ? "polygon-driven" : "point-driven")
+                      << " (estimated cost: " << costs.point_driven << " point-driven, "
+                      << costs.polygon_driven << " polygon-driven)" << std::endl;
+    }
+
+    if (strategy == POLYGON_DRIVEN)
+    {
+        std::vector<double> rank;
+
+        if (policy == SMALLEST_AREA)
+            rank = polys.get_areas();
+        else if (policy == HIGHEST_PRIORITY)
+            for (double p : opts.priorities)
+                rank.push_back(-p);
+
+        classify_by_polygon(polys, rank, x, y, z, n, point2region, verbose);
+    }
+    else if (opts.halo > 0.0)
+    {
+        classify_batch(polys, x, y, z, n, point2region, verbose);
+    }
+    else
+    {
+        classify(polys, opts.policy, opts.priorities, x, y, z, n, point2region, point_regions, verbose);
+    }
+
+    if (opts.halo > 0.0)
+        assign_halo(polys, edges, x, y, z, n, point2region, opts.halo, point_regions);
+
+    if (opts.nearest > 0.0)
+    {
+        if (opts.multi())
+            assign_nearest(edges, x, y, z, n, opts.nearest, point_regions);
+        else
+            assign_nearest(edges, x, y, z, n, opts.nearest, point2region);
+    }
+}
+
+PIP_INLINE
+void assign_nearest (const SegmentGrid &edges, const double *x, const double *y, const double *z, const size_t n,
+                     const double max_d, uint *point2region)
+{
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int64_t j = 0; j < (int64_t) n; j++)
+    {
+        double dist;
+
+        if (point2region[j] == UINT_MAX)
+            point2region[j] = edges.nearest_polygon(x[j], y[j], max_d, dist, z ? z[j] : NAN);
+    }
+}
+
+PIP_INLINE
+void assign_nearest (const SegmentGrid &edges, const double *x, const double *y, const double *z, const size_t n,
+                     const double max_d, PointRegions &pr)
+{
+    PointRegions filled;
+
+    build_point_regions(n, [&](const size_t j, std::vector<uint> &out)
+    {
+        GISSpan<const uint> regions = pr.of(j);
+
+        if (!regions.empty())
+        {
+            out.assign(regions.begin(), regions.end());
+            return;
+        }
+
+        double dist;
+        uint pid = edges.nearest_polygon(x[j], y[j], max_d, dist, z ? z[j] : NAN);
+
+        if (pid != UINT_MAX)
+            out.push_back(pid);
+    }, filled);
+
+    std::swap(pr, filled);
+}
+
+PIP_INLINE
+RegionPoints unassigned_points (const std::vector<uint> &point2region)
+{
+    RegionPoints rp;
+
+    build_region_points(point2region.size(), 1, [&point2region] (const size_t j, const auto &visit)
+    {
+        if (point2region[j] == UINT_MAX) visit(0);
+    }, rp);
+
+    return rp;
+}
+
+PIP_INLINE
+RegionPoints unassigned_points (const PointRegions &point_regions)
+{
+    RegionPoints rp;
+
+    build_region_points(point_regions.num_points(), 1, [&point_regions] (const size_t j, const auto &visit)
+    {
+        if (point_regions.of(j).empty()) visit(0);
+    }, rp);
+
+    return rp;
+}
+
+PIP_INLINE
+RegionPoints group_by_region (const std::vector<uint> &point2region, const uint n_regions)
+{
+    RegionPoints rp;
+
+    build_region_points(point2region.size(), n_regions, [&point2region] (const size_t j, const auto &visit)
+    {
+        if (point2region[j] < UINT_MAX) visit(point2region[j]);
+    }, rp);
+
+    return rp;
+}
+
+PIP_INLINE
+RegionPoints group_by_region (const PointRegions &point_regions, const uint n_regions)
+{
+    RegionPoints rp;
+
+    build_region_points(point_regions.num_points(), n_regions, [&point_regions] (const size_t j, const auto &visit)
+    {
+        for (uint pid : point_regions.of(j)) visit(pid);
+    }, rp);
+
+    return rp;
+}
+
+}
@@ -0,0 +1,320 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
+#include "../utils/pip_inline.h"
+#include "polygon_set.h"
+#include "mesh_locator.h"
+#include "segment_grid.h"
+#include "../utils/point_ids.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Region assigned to a point lying in several (overlapping) regions
+enum OverlapPolicy
+{
+    FIRST_REGION,     // lowest id
+    ALL_REGIONS,      // all of them (PointRegions)
+    SMALLEST_AREA,    // smallest area, then lowest id
+    HIGHEST_PRIORITY  // highest priority (e.g. from an attribute), then lowest id
+};
+
+// "first", "all", "smallest", "priority"
+bool parse_overlap_policy (const std::string &s, OverlapPolicy &policy);
+
+// How the points are matched to the regions
+enum ClassifyStrategy
+{
+    AUTO_STRATEGY,    // picked by the cost model (see estimate_strategy_costs())
+    POINT_DRIVEN,     // each point tests the regions of its cell of the region grid
+    POLYGON_DRIVEN    // each region scans the cells of a grid over the points (see classify_by_polygon())
+};
+
+// "auto", "points", "polygons"
+bool parse_strategy (const std::string &s, ClassifyStrategy &strategy);
+
+// How points are assigned to regions
+class AssignmentOptions
+{
+public:
+
+    OverlapPolicy policy = FIRST_REGION;
+    std::vector<double> priorities;  // one per region, for HIGHEST_PRIORITY
+    double halo = 0.0;               // see assign_halo()
+    double nearest = 0.0;            // max distance of the nearest-region fallback, see assign_nearest()
+    ClassifyStrategy strategy = AUTO_STRATEGY;
+
+    // points may get several regions
+    bool multi () const { return policy == ALL_REGIONS || halo > 0.0; }
+
+    // the segment grid is used
+    bool uses_edges () const { return halo > 0.0 || nearest > 0.0; }
+
+    // farthest a point can lie outside the bbox of its region
+    double reach () const { return std::max(halo, nearest); }
+};
+
+// Regions of each point, when a point may belong to several of them, in CSR form:
+// the regions of point j are regions[offsets[j] .. offsets[j+1]), in increasing order
+class PointRegions
+{
+public:
+
+    std::vector<uint64_t> offsets = {0};
+    std::vector<uint>     regions;
+
+    size_t num_points () const { return offsets.size()-1; }
+
+    GISSpan<const uint> of (const size_t j) const
+    {
+        return GISSpan<const uint>(regions.data() + offsets[j], offsets[j+1] - offsets[j]);
+    }
+};
+
+// Fills pr in parallel: regions_of(j, out) writes the regions of point j to out
+// (a per-thread vector) and must be thread-safe.
+// Each thread handles a contiguous block of points; blocks are then concatenated.
+template<class F>
+void build_point_regions (const size_t n, const F &regions_of, PointRegions &pr)
+{
+    pr.offsets.assign(n+1, 0);
+
+    std::vector<std::vector<uint>> block_regions;
+
+    #pragma omp parallel
+    {
+        const size_t n_threads = omp_get_num_threads();
+        const size_t t = omp_get_thread_num();
+
+        #pragma omp single
+        block_regions.resize(n_threads);
+
+        std::vector<uint> out;
+
+        for (size_t j = (n * t) / n_threads; j < (n * (t+1)) / n_threads; j++)
+        {
+            out.clear();
+            regions_of(j, out);
+
+            pr.offsets[j+1] = out.size();
+            block_regions[t].insert(block_regions[t].end(), out.begin(), out.end());
+        }
+    }
+
+    for (size_t j = 1; j <= n; j++)
+        pr.offsets[j] += pr.offsets[j-1];
+
+    pr.regions.resize(pr.offsets[n]);
+
+    const size_t n_blocks = block_regions.size();
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t t = 0; t < (int64_t) n_blocks; t++)
+        std::copy(block_regions[t].begin(), block_regions[t].end(),
+                  pr.regions.begin() + pr.offsets[(n * t) / n_blocks]);
+}
+
+// Points of each region, in CSR form over (region, chunk) buckets (see PointIds):
+// the offsets of the points of region pid in chunk c are points[offsets[b] .. offsets[b+1]),
+// with b = pid * n_chunks + c, in increasing order
+class RegionPoints
+{
+public:
+
+    std::vector<uint64_t> offsets = {0};
+    std::vector<uint>     points;
+    size_t                n_chunks = 1;
+
+    size_t num_regions () const { return (offsets.size()-1) / n_chunks; }
+
+    PointIds of (const size_t pid) const
+    {
+        return PointIds(points.data(), offsets.data() + pid * n_chunks, n_chunks);
+    }
+};
+
+// max entries of the per-block histograms of build_region_points()
+const size_t REGION_HISTOGRAM_ENTRIES = 1 << 24;
+
+// Fills rp by a parallel counting sort of the n points: regions_of(j, visit) calls
+// visit(pid) for each region pid < n_regions of point j and must be thread-safe.
+// Points are split in contiguous blocks; each block counts its points per bucket,
+// a prefix sum over (bucket, block) gives where each block writes, and the blocks
+// then scatter their points in parallel. Blocks are fewer than the threads when the
+// histograms (one per block, one entry per bucket) would grow too large.
+template<class F>
+void build_region_points (const size_t n, const uint n_regions, const F &regions_of, RegionPoints &rp)
+{
+    const size_t n_chunks  = num_point_chunks(n);
+    const size_t n_buckets = size_t(n_regions) * n_chunks;
+
+    rp.n_chunks = n_chunks;
+    rp.offsets.assign(n_buckets+1, 0);
+
+    const size_t n_blocks = std::max(size_t(1), std::min(size_t(omp_get_max_threads()),
+                                                         REGION_HISTOGRAM_ENTRIES / std::max(n_buckets, size_t(1))));
+
+    std::vector<uint64_t> starts (n_blocks * n_buckets, 0);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int64_t b = 0; b < (int64_t) n_blocks; b++)
+    {
+        uint64_t *count = starts.data() + b * n_buckets;
+
+        for (size_t j = (n * b) / n_blocks; j < (n * (b+1)) / n_blocks; j++)
+        {
+            const size_t c = point_chunk(j);
+            regions_of(j, [count, c, n_chunks] (const uint pid) { count[pid * n_chunks + c]++; });
+        }
+    }
+
+    // counts -> start of each (bucket, block) range
+    uint64_t total = 0;
+
+    for (size_t k = 0; k < n_buckets; k++)
+    {
+        for (size_t b = 0; b < n_blocks; b++)
+        {
+            uint64_t count = starts[b * n_buckets + k];
+            starts[b * n_buckets + k] = total;
+            total += count;
+        }
+
+        rp.offsets[k+1] = total;
+    }
+
+    rp.points.resize(total);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int64_t b = 0; b < (int64_t) n_blocks; b++)
+    {
+        uint64_t *next = starts.data() + b * n_buckets;
+        uint *points = rp.points.data();
+
+        for (size_t j = (n * b) / n_blocks; j < (n * (b+1)) / n_blocks; j++)
+        {
+            const size_t c = point_chunk(j);
+            const uint   o = point_offset(j);
+            regions_of(j, [next, points, c, o, n_chunks] (const uint pid) { points[next[pid * n_chunks + c]++] = o; });
+        }
+    }
+}
+
+// Region of each of the n points (x[i], y[i]): the first polygon, in id order,
+// containing it, or UINT_MAX. Points are processed in parallel, in chunks;
+// with verbose set, progress is printed after every chunk.
+void classify (const PolygonSet &polys, const double *x, const double *y, const size_t n,
+               uint *point2region, const bool verbose = false);
+
+// Batched variant, same result as classify(): points are bucketed by grid cell and,
+// within a cell, each candidate polygon is tested against all the points still
+// unassigned at once, so that its edges are loaded once per cell instead of once
+// per point. Cells are processed in parallel.
+// z holds the Z of the points, or is null: when the polygons have prism bounds (see
+// PolygonSet::set_z_bounds()) a region only contains the points within its Z range.
+// With z null, or no prism bounds, points are 2D. The functions below take z alike.
+void classify_batch (const PolygonSet &polys, const double *x, const double *y, const double *z, const size_t n,
+                     uint *point2region, const bool verbose = false);
+
+// Region of each point according to an overlap policy: FIRST_REGION as classify_batch(),
+// ALL_REGIONS fills point_regions and leaves point2region to UINT_MAX, the others pick,
+// among the candidates of the grid containing the point, the one with the best key
+// (priorities holds one value per region, for HIGHEST_PRIORITY).
+void classify (const PolygonSet &polys, const OverlapPolicy policy, const std::vector<double> &priorities,
+               const double *x, const double *y, const double *z, const size_t n,
+               uint *point2region, PointRegions &point_regions, const bool verbose = false);
+
+// Containing region with the lowest rank (ties: lowest id), or UINT_MAX.
+// Candidates ranked worse than the best region found so far are not tested.
+void classify_ranked (const PolygonSet &polys, const std::vector<double> &rank,
+                      const double *x, const double *y, const double *z, const size_t n, uint *point2region);
+
+// Polygon-driven variant of classify_ranked() (with an empty rank, of classify_batch()),
+// for few regions over many points: the points are bucketed in a PointGrid and the regions
+// are visited from the best ranked one, each scanning the cells overlapping its bbox.
+// A cell crossed by none of its edges lies entirely inside or outside it: its points are
+// assigned at once if the cell center is inside. The points of the other cells are
+// tested one by one. A point keeps the first region found containing it.
+void classify_by_polygon (const PolygonSet &polys, const std::vector<double> &rank,
+                          const double *x, const double *y, const double *z, const size_t n,
+                          uint *point2region, const bool verbose = false);
+
+// Estimated cost of classifying a set of points with each strategy
+class StrategyCosts
+{
+public:
+
+    double point_driven   = 0.0;
+    double polygon_driven = 0.0;
+
+    ClassifyStrategy best () const { return polygon_driven < point_driven ? POLYGON_DRIVEN : POINT_DRIVEN; }
+};
+
+// Cost model of the two strategies, assuming points spread evenly over their bbox.
+// Point-driven: every point looking up its cell, plus the edges tested by the points in
+// the bbox of each region (all of them, but for the share of the bbox covered by the
+// inner boxes of the region). Polygon-driven: bucketing the points, plus, for each region,
+// scanning the cells under its bbox and testing the points of the cells along its boundary
+// (about one cell per vertex, plus one per cell size of perimeter) against all its edges.
+StrategyCosts estimate_strategy_costs (const PolygonSet &polys, const double *x, const double *y, const size_t n);
+
+// All the regions containing each point
+void assign_all (const PolygonSet &polys, const double *x, const double *y, const double *z, const size_t n,
+                 PointRegions &pr);
+
+// Same, locating the points in the cells of a tessellation by adjacency walking:
+// each thread processes a contiguous block of points, starting every query
+// from the cell of its previous point.
+void classify (const MeshLocator &locator, const double *x, const double *y, const size_t n,
+               uint *point2region, const bool verbose = false);
+
+// Halo assignment: each point goes to its owner (point2region, from classify()) and to every
+// region within distance d: those containing it (region grid) and those with an edge
+// closer than d (segment grid)
+void assign_halo (const PolygonSet &polys, const SegmentGrid &edges, const double *x, const double *y, const double *z,
+                  const size_t n, const uint *point2region, const double d, PointRegions &pr);
+
+// Nearest-region fallback: each point with no region gets the region with the nearest
+// edge, if closer than max_d
+void assign_nearest (const SegmentGrid &edges, const double *x, const double *y, const double *z, const size_t n,
+                     const double max_d, uint *point2region);
+void assign_nearest (const SegmentGrid &edges, const double *x, const double *y, const double *z, const size_t n,
+                     const double max_d, PointRegions &pr);
+
+// Regions of each point according to the options: with multi(), they are stored in
+// point_regions, otherwise point2region holds them. With a halo, every region containing
+// a point is within the halo: the policy does not matter. Edges must be built if uses_edges().
+// Except for ALL_REGIONS, the containing region is found with opts.strategy (with
+// verbose set, the strategy picked by the cost model is printed).
+void assign_regions (const PolygonSet &polys, const AssignmentOptions &opts, const SegmentGrid &edges,
+                     const double *x, const double *y, const double *z, const size_t n,
+                     uint *point2region, PointRegions &point_regions, const bool verbose = false);
+
+// Points with no region, as the only region of a RegionPoints
+RegionPoints unassigned_points (const std::vector<uint> &point2region);
+RegionPoints unassigned_points (const PointRegions &point_regions);
+
+// Points of each region, in increasing order (see build_region_points())
+RegionPoints group_by_region (const std::vector<uint> &point2region, const uint n_regions);
+RegionPoints group_by_region (const PointRegions &point_regions, const uint n_regions);
+
+}
+
+#ifndef static_lib
+#include "classifier.cpp"
+#endif
+
+#endif // CLASSIFIER_H
@@ -0,0 +1,465 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "incremental.h"
+#include "classifier.h"
+#include "region_grid.h"
+#include "segment_grid.h"
+#include "../io/read_LAS.h"
+#include "../io/write_LAS.h"
+
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+uint64_t region_hash (const PolygonSet &polys, const uint pid, const std::vector<double> &priorities)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+
+    auto add = [&](const void *data, const size_t n)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t*>(data);
+
+        for (size_t i=0; i < n; i++)
+            h = (h ^ bytes[i]) * 1099511628211ull;
+    };
+
+    auto add_value = [&](const auto v) { add(&v, sizeof(v)); };
+
+    add_value(uint64_t(polys.poly_ring_end(pid) - polys.poly_ring_begin(pid)));
+
+    for (uint64_t r = polys.poly_ring_begin(pid); r < polys.poly_ring_end(pid); r++)
+    {
+        const uint64_t begin = polys.ring_vert_begin(r);
+        const uint64_t end   = polys.ring_vert_end(r);
+
+        add_value(uint64_t(end - begin));
+        add(polys.get_xs() + begin, (end - begin) * sizeof(double));
+        add(polys.get_ys() + begin, (end - begin) * sizeof(double));
+    }
+
+    add_value(uint8_t(polys.has_z_bounds()));
+
+    if (polys.has_z_bounds())
+    {
+        add_value(polys.z_min(pid));
+        add_value(polys.z_max(pid));
+    }
+
+    add_value(uint8_t(!priorities.empty()));
+
+    if (!priorities.empty())
+        add_value(priorities.at(pid));
+
+    return h;
+}
+
+PIP_INLINE
+void LayerManifest::set_run (const PolygonSet &polys, const std::string &las,
+                             const AssignmentOptions &opts, const LASFilter &f)
+{
+    std::error_code ec;   // a missing input is reported when it is read
+
+    las_path = fs::absolute(las).string();
+    las_size = fs::file_size(las, ec);
+    policy   = opts.policy;
+    halo     = opts.halo;
+    nearest  = opts.nearest;
+    filter   = f.expression;
+
+    hashes.resize(polys.num_polygons());
+    bboxes = polys.get_bboxes();
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int64_t pid = 0; pid < int64_t(hashes.size()); pid++)
+        hashes[pid] = region_hash(polys, uint(pid), opts.priorities);
+}
+
+PIP_INLINE
+bool LayerManifest::read (const std::string &filename)
+{
+    std::ifstream ifs (filename);
+
+    if (!ifs.is_open())
+        return false;
+
+    std::string key;
+    bool has_regions = false;
+
+    while (ifs >> key)
+    {
+        if      (key == "las_path")  { ifs >> std::ws; std::getline(ifs, las_path); }
+        else if (key == "las_size")  ifs >> las_size;
+        else if (key == "policy")    ifs >> policy;
+        else if (key == "halo")      ifs >> halo;
+        else if (key == "nearest")   ifs >> nearest;
+        else if (key == "filter")    { ifs >> std::ws; std::getline(ifs, filter); }
+        else if (key == "regions")
+        {
+            size_t n;
+            ifs >> n;
+            hashes.assign(n, 0);
+            bboxes.assign(n, BBox2());
+            has_regions = true;
+        }
+        else if (key == "region")
+        {
+            size_t pid;
+            uint64_t h;
+            BBox2 b;
+            ifs >> pid >> h >> b.xmin >> b.ymin >> b.xmax >> b.ymax;
+
+            if (pid >= hashes.size())
+                return false;
+
+            hashes.at(pid) = h;
+            bboxes.at(pid) = b;
+        }
+        else
+            return false;
+
+        if (ifs.fail())
+            return false;
+    }
+
+    return has_regions;
+}
+
+PIP_INLINE
+bool LayerManifest::write (const std::string &filename) const
+{
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream ofs (tmp);
+
+        if (!ofs.is_open())
+        {
+            std::cerr << "Error writing manifest: " << tmp << std::endl;
+            return false;
+        }
+
+        // bboxes must read back exactly
+        ofs << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+        ofs << "las_path " << las_path << "\n"
+            << "las_size " << las_size << "\n"
+            << "policy "   << policy   << "\n"
+            << "halo "     << halo     << "\n"
+            << "nearest "  << nearest  << "\n";
+
+        if (!filter.empty())
+            ofs << "filter "   << filter   << "\n";
+
+        ofs << "regions "  << hashes.size() << "\n";
+
+        for (size_t pid=0; pid < hashes.size(); pid++)
+        {
+            const BBox2 &b = bboxes.at(pid);
+            ofs << "region " << pid << " " << hashes.at(pid) << " " << b.xmin << " " << b.ymin << " " << b.xmax << " " << b.ymax << "\n";
+        }
+
+        ofs.flush();
+
+        if (ofs.fail())
+        {
+            std::cerr << "Error writing manifest: " << tmp << std::endl;
+            return false;
+        }
+    }
+
+    fs::rename(tmp, filename);
+    return true;
+}
+
+PIP_INLINE
+bool LayerManifest::same_run (const LayerManifest &m) const
+{
+    return las_path == m.las_path && las_size == m.las_size && policy == m.policy &&
+           halo == m.halo && nearest == m.nearest && filter == m.filter;
+}
+
+PIP_INLINE
+std::string layer_manifest_path (const std::string &folder)
+{
+    return (fs::path(folder) / "layer_manifest.txt").string();
+}
+
+// Appends to points the points of a LAS file written by a previous run (if it exists)
+// for which keep(x,y) holds. They get the given header, which has the same point
+// format, scale and offset as the one of the file.
+template<class F>
+bool read_kept_points (const std::string &filename, const liblas::Header &header,
+                       const F &keep, std::vector<liblas::Point> &points)
+{
+    if (!fs::exists(filename))
+        return true;
+
+    std::ifstream ifs (filename, std::ios::in | std::ios::binary);
+
+    if (!ifs.is_open())
+    {
+        std::cerr << "Error opening LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    liblas::Reader reader(ifs);
+
+    while (reader.ReadNextPoint())
+    {
+        const liblas::Point &p = reader.GetPoint();
+
+        if (!keep(p.GetX(), p.GetY()))
+            continue;
+
+        points.push_back(p);
+        points.back().SetHeader(&header);
+    }
+
+    return true;
+}
+
+// Writes points to a temporary file, then renames it to filename: a crash leaves the previous file
+PIP_INLINE
+bool replace_LAS (const std::string &filename, const liblas::Header &header, const std::vector<liblas::Point> &points)
+{
+    std::string tmp = filename + ".tmp";
+
+    if (!write_LAS(tmp, header, points, PointIds::all(points.size())))
+        return false;
+
+    fs::rename(tmp, filename);
+    return true;
+}
+
+PIP_INLINE
+bool partition_LAS_incremental (const PolygonSet &polys, const LayerManifest &previous,
+                                const LayerManifest &current, const std::string &las_path,
+                                const std::string &output_folder,
+                                const AssignmentOptions &opts, const LASFilter &filter,
+                                const bool verbose)
+{
+    const double reach = opts.reach();
+    const bool   write_unassigned = opts.nearest > 0.0;
+    const uint   nRegions  = polys.num_polygons();
+    const uint   nPrevious = previous.hashes.size();
+
+    auto grow = [&](BBox2 b)
+    {
+        if (b.empty()) return b;
+
+        b.xmin -= reach; b.ymin -= reach;
+        b.xmax += reach; b.ymax += reach;
+        return b;
+    };
+
+    auto region_folder = [&](const uint pid) { return fs::path(region_LAS_path(output_folder, pid)).parent_path(); };
+
+    ///
+    // Dirty area: the old and new bboxes of the changed regions, grown by the reach
+
+    std::vector<BBox2> dirty;
+    std::vector<bool>  changed (std::max(nRegions, nPrevious), false);
+    size_t n_changed = 0;
+
+    for (uint pid=0; pid < changed.size(); pid++)
+    {
+        changed.at(pid) = pid >= nRegions || pid >= nPrevious || current.hashes.at(pid) != previous.hashes.at(pid);
+
+        if (!changed.at(pid)) continue;
+
+        n_changed++;
+
+        if (pid < nPrevious && !previous.bboxes.at(pid).empty())
+            dirty.push_back(grow(previous.bboxes.at(pid)));
+
+        if (pid < nRegions && !polys.bbox(pid).empty())
+            dirty.push_back(grow(polys.bbox(pid)));
+    }
+
+    std::cout << "Incremental update: " << n_changed << " changed regions (" << nPrevious
+              << " regions in the previous run, " << nRegions << " now)" << std::endl;
+
+    // removed regions
+    for (uint pid=nRegions; pid < nPrevious; pid++)
+        fs::remove_all(region_folder(pid));
+
+    if (dirty.empty())
+        return true;
+
+    RegionGrid dirty_index;
+    dirty_index.build(dirty);
+
+    auto in_dirty = [&](const double x, const double y)
+    {
+        for (uint d : dirty_index.candidates(x, y))
+            if (dirty.at(d).contains(x, y))
+                return true;
+
+        return false;
+    };
+
+    auto meets_dirty = [&](const BBox2 &b)
+    {
+        const BBox2 &e = dirty_index.get_extent();
+
+        if (b.empty() || !b.overlaps(e))
+            return false;
+
+        uint cx0, cy0, cx1, cy1;
+        dirty_index.cell_of(std::max(b.xmin, e.xmin), std::max(b.ymin, e.ymin), cx0, cy0);
+        dirty_index.cell_of(std::min(b.xmax, e.xmax), std::min(b.ymax, e.ymax), cx1, cy1);
+
+        for (uint cy=cy0; cy <= cy1; cy++)
+            for (uint cx=cx0; cx <= cx1; cx++)
+                for (uint d : dirty_index.cell_candidates(cx, cy))
+                    if (dirty.at(d).overlaps(b))
+                        return true;
+
+        return false;
+    };
+
+    // regions that may gain or lose points
+    std::vector<uint8_t> affected (nRegions, 0);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int64_t pid = 0; pid < int64_t(nRegions); pid++)
+        affected[pid] = changed[pid] || meets_dirty(grow(polys.bbox(pid)));
+
+    ///
+    // Points of the input cloud in the dirty area: the whole cloud is scanned
+
+    std::ifstream ifs;
+    ifs.open(las_path.c_str(), std::ios::in | std::ios::binary);
+
+    if (!ifs.is_open())
+    {
+        std::cerr << "Error opening LAS file: " << las_path << std::endl;
+        return false;
+    }
+
+    liblas::Reader reader(ifs);
+    liblas::Header header = reader.GetHeader();
+
+    LASPredicate pred;
+
+    if (!filter.compile(header, pred))
+        return false;
+
+    std::vector<liblas::Point> points;
+    std::vector<double> xs, ys, zs;   // zs only for prisms
+
+    {
+        size_t nRead = 0;
+
+        while (reader.ReadNextPoint())
+        {
+            const liblas::Point &p = reader.GetPoint();
+
+            if (verbose && (++nRead % (1 << 24)) == 0)
+                std::cout << "Scanned " << nRead << " points..." << std::endl;
+
+            if (!in_dirty(p.GetX(), p.GetY()) || !pred.accept(p))
+                continue;
+
+            points.push_back(p);
+            points.back().SetHeader(&header);
+
+            xs.push_back(p.GetX());
+            ys.push_back(p.GetY());
+
+            if (polys.has_z_bounds())
+                zs.push_back(p.GetZ());
+        }
+    }
+
+    ifs.close();
+
+    std::vector<uint> point2region (points.size(), UINT_MAX);
+    PointRegions point_regions;
+
+    {
+        SegmentGrid edges;
+
+        if (opts.uses_edges())
+            edges.build(polys);
+
+        assign_regions(polys, opts, edges, xs.data(), ys.data(), zs.empty() ? nullptr : zs.data(), xs.size(),
+                       point2region.data(), point_regions, verbose);
+    }
+
+    RegionPoints region2point = opts.multi() ? group_by_region(point_regions, nRegions)
+                                             : group_by_region(point2region, nRegions);
+
+    // a region getting points of the dirty area reaches it: already affected
+    for (uint pid=0; pid < nRegions; pid++)
+        if (!region2point.of(pid).empty())
+            affected.at(pid) = 1;
+
+    size_t n_affected = std::count(affected.begin(), affected.end(), 1);
+
+    std::cout << points.size() << " points in the dirty area, " << n_affected << " regions to rewrite" << std::endl;
+
+    ///
+    // Rewrite the affected regions: previous points outside the dirty area, new points inside it
+
+    auto keep = [&](const double x, const double y) { return !in_dirty(x, y); };
+
+    std::vector<liblas::Point> region_points;
+
+    for (uint pid=0; pid < nRegions; pid++)
+    {
+        if (!affected.at(pid)) continue;
+
+        std::string filename = region_LAS_path(output_folder, pid);
+
+        region_points.clear();
+
+        if (!read_kept_points(filename, header, keep, region_points))
+            return false;
+
+        region2point.of(pid).for_each([&] (const uint64_t j) { region_points.push_back(points.at(j)); });
+
+        if (region_points.empty())
+        {
+            std::cout << "Region " << pid << " has no points." << std::endl;
+            fs::remove_all(region_folder(pid));
+        }
+        else if (!replace_LAS(filename, header, region_points))
+            return false;
+    }
+
+    if (write_unassigned)
+    {
+        std::string filename = output_folder + "/unassigned.las";
+
+        region_points.clear();
+
+        if (!read_kept_points(filename, header, keep, region_points))
+            return false;
+
+        RegionPoints unassigned = opts.multi() ? unassigned_points(point_regions) : unassigned_points(point2region);
+        unassigned.of(0).for_each([&] (const uint64_t j) { region_points.push_back(points.at(j)); });
+
+        if (!replace_LAS(filename, header, region_points))
+            return false;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,85 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "../utils/pip_inline.h"
+#include "polygon_set.h"
+#include "classifier.h"
+#include "../io/filter_LAS.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Hash of everything that decides which points region pid gets: its rings, its
+// Z bounds (prisms) and its priority (if any)
+uint64_t region_hash (const PolygonSet &polys, const uint pid, const std::vector<double> &priorities);
+
+// Record of the polygon layer a partitioning run was made with, stored in
+// <output>/layer_manifest.txt: the run parameters (to detect a changed input) and,
+// for each region (feature id), its hash and bbox
+class LayerManifest
+{
+public:
+
+    std::string las_path;
+    uintmax_t   las_size = 0;
+    int         policy = FIRST_REGION;
+    double      halo = 0.0;
+    double      nearest = 0.0;
+    std::string filter;                // expression of the point filter, if any
+
+    std::vector<uint64_t> hashes;      // region -> region_hash()
+    std::vector<BBox2>    bboxes;      // region -> bbox
+
+    // run parameters and regions of a run of polys on las_path
+    void set_run (const PolygonSet &polys, const std::string &las_path,
+                  const AssignmentOptions &opts, const LASFilter &filter);
+
+    bool read (const std::string &filename);
+
+    // written to a temporary file, then renamed: a crash leaves the previous record
+    bool write (const std::string &filename) const;
+
+    // same input and parameters (the regions may differ)
+    bool same_run (const LayerManifest &m) const;
+};
+
+// <folder>/layer_manifest.txt
+std::string layer_manifest_path (const std::string &folder);
+
+// Updates the outputs of a run recorded by previous to the regions of current (polys),
+// rewriting only the regions the change of the layer can affect.
+// A region has changed if it is new, removed, or its hash differs. The points whose
+// region may change are those within reach (halo or fallback distance) of the old or
+// new bbox of a changed region: the dirty area. The whole input cloud is still read, as
+// it has no spatial index, but only its points in the dirty area are tested against filter
+// and classified (with no changed region, it is not read at all). Each region whose
+// bbox, grown by the reach, meets the dirty area is rewritten with its previous points
+// outside the dirty area plus its new points inside it. The same goes for unassigned.las
+// with the fallback enabled. Removed regions, and regions left without points, have their
+// folder deleted. Within a rewritten region the points are no longer in input order.
+// A crash leaves the previous manifest in place: running again completes the update.
+bool partition_LAS_incremental (const PolygonSet &polys, const LayerManifest &previous,
+                                const LayerManifest &current, const std::string &las_path,
+                                const std::string &output_folder,
+                                const AssignmentOptions &opts = AssignmentOptions(),
+                                const LASFilter &filter = LASFilter(),
+                                const bool verbose = false);
+
+}
+
+#ifndef static_lib
+#include "incremental.cpp"
+#endif
+
+#endif // INCREMENTAL_H
@@ -0,0 +1,146 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "mesh_locator.h"
+#include "../utils/profiler.h"
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+MeshLocator::MeshLocator (const cinolib::Polygonmesh<> &m, const uint max_walk_steps) : max_steps(max_walk_steps)
+{
+    ring_offsets.reserve(m.num_polys()+1);
+    ring_offsets.push_back(0);
+    bboxes.resize(m.num_polys());
+    ccw.resize(m.num_polys());
+
+    for (uint pid=0; pid < m.num_polys(); pid++)
+    {
+        const std::vector<uint> &vids = m.adj_p2v(pid);
+
+        double area = 0.0;
+
+        for (uint k=0; k < vids.size(); k++)
+        {
+            uint v0 = vids.at(k);
+            uint v1 = vids.at((k+1) % vids.size());
+
+            xs.push_back(m.vert(v0).x());
+            ys.push_back(m.vert(v0).y());
+            bboxes.at(pid).add(m.vert(v0).x(), m.vert(v0).y());
+
+            area += m.vert(v0).x() * m.vert(v1).y() - m.vert(v1).x() * m.vert(v0).y();
+
+            int neighbor = -1;
+            int eid = m.edge_id(v0, v1);
+
+            if (eid >= 0)
+                for (uint adj : m.adj_e2p(eid))
+                    if (adj != pid)
+                        neighbor = adj;
+
+            edge_neighbors.push_back(neighbor);
+        }
+
+        ccw.at(pid) = (area >= 0.0) ? 1 : -1;
+        ring_offsets.push_back(xs.size());
+    }
+
+    grid.build(bboxes);
+}
+
+PIP_INLINE
+bool MeshLocator::inside (const uint pid, const double x, const double y) const
+{
+    PIP_COUNT(PNPOLY_CALLS, 1);
+
+    if (!bboxes[pid].contains(x, y))
+    {
+        PIP_COUNT(BBOX_REJECTIONS, 1);
+        return false;
+    }
+
+    uint64_t begin = ring_offsets[pid];
+    uint64_t end   = ring_offsets[pid+1];
+
+    PIP_COUNT(EDGES_TESTED, end - begin);
+
+    int c = 0;
+
+    for (uint64_t i = begin, j = end - 1; i < end; j = i++)
+    {
+        if (((ys[i] > y) != (ys[j] > y)) &&
+            (x < (xs[j] - xs[i]) * (y - ys[i]) / (ys[j] - ys[i]) + xs[i]))
+            c = !c;
+    }
+
+    return c;
+}
+
+PIP_INLINE
+int MeshLocator::locate (const double x, const double y, const int hint, bool &walked) const
+{
+    walked = false;
+
+    if (hint >= 0 && hint < (int) num_cells())
+    {
+        int curr = hint;
+        int prev = -1;
+
+        for (uint step=0; step < max_steps && curr >= 0; step++)
+        {
+            PIP_COUNT(WALK_STEPS, 1);
+
+            if (inside(curr, x, y))
+            {
+                walked = true;
+                return curr;
+            }
+
+            // cross an edge that has the point on its outer side
+            uint64_t begin = ring_offsets[curr];
+            uint64_t end   = ring_offsets[curr+1];
+
+            int next = -1;
+
+            for (uint64_t i = begin; i < end; i++)
+            {
+                uint64_t j = (i+1 < end) ? i+1 : begin;
+
+                double orient = (xs[j] - xs[i]) * (y - ys[i]) - (ys[j] - ys[i]) * (x - xs[i]);
+
+                if (orient * ccw[curr] < 0.0 && edge_neighbors[i] >= 0 && edge_neighbors[i] != prev)
+                {
+                    next = edge_neighbors[i];
+                    break;
+                }
+            }
+
+            prev = curr;
+            curr = next;
+        }
+    }
+
+    return locate_indexed(x, y);
+}
+
+PIP_INLINE
+int MeshLocator::locate_indexed (const double x, const double y) const
+{
+    GISSpan<const uint> candidates = grid.candidates(x, y);
+
+    PIP_COUNT(INDEX_CANDIDATES, candidates.size());
+
+    for (uint pid : candidates)
+        if (inside(pid, x, y))
+            return pid;
+
+    return -1;
+}
+
+}
@@ -0,0 +1,65 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef MESH_LOCATOR_H
+#define MESH_LOCATOR_H
+
+#include "../utils/pip_inline.h"
+#include "region_grid.h"
+
+#include <cinolib/meshes/meshes.h>
+
+namespace URBAN3D
+{
+
+// Point location in the cells of a polygonal tessellation.
+// A query starts from a hint cell (typically the cell of the previous point) and
+// walks across shared edges towards the point; the region grid over the cell bboxes
+// is only used when there is no hint or the walk does not converge.
+// Cells follow the crossing rule of pnpoly(): a point on an edge shared by two cells
+// belongs to the cell on its right (+x), or above it (+y) for a horizontal edge, and
+// points on the right or top boundary of the mesh are outside. On slanted shared edges
+// the two cells may round differently, as they walk the edge in opposite directions.
+class MeshLocator
+{
+private:
+
+    // flat copy of the cells: ring coordinates and, per edge (v_k, v_k+1),
+    // the cell on the other side (-1 on the boundary)
+    std::vector<uint64_t> ring_offsets;
+    std::vector<double>   xs, ys;
+    std::vector<int>      edge_neighbors;
+    std::vector<int8_t>   ccw;
+
+    std::vector<BBox2> bboxes;
+    RegionGrid grid;
+
+    uint max_steps;
+
+    bool inside (const uint pid, const double x, const double y) const;
+
+public:
+
+    MeshLocator (const cinolib::Polygonmesh<> &m, const uint max_walk_steps = 64);
+
+    uint num_cells () const { return bboxes.size(); }
+
+    // cell containing (x,y), or -1. `walked` reports whether the walk succeeded
+    // (false when the grid fallback was used)
+    int locate (const double x, const double y, const int hint, bool &walked) const;
+
+    // cell containing (x,y) through the grid only, or -1
+    int locate_indexed (const double x, const double y) const;
+};
+
+}
+
+#ifndef static_lib
+#include "mesh_locator.cpp"
+#endif
+
+#endif // MESH_LOCATOR_H
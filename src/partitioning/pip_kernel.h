@@ -0,0 +1,228 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef PIP_KERNEL_H
+#define PIP_KERNEL_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Crossing-number (even-odd) point-in-polygon kernels, specialized at compile time on
+// the coordinate type and on the ring layout of the polygon. The caller picks the
+// instance once per polygon (see PolygonSet::contains()), so that the inner loops
+// carry no per-edge dispatch.
+//
+// Coordinate types:
+//   double   the reference test, as used everywhere else in the library
+//   float    coordinates relative to a local origin (e.g. the bbox corner of the polygon):
+//            twice the SIMD lanes, with a tolerance band flagging the points whose answer
+//            may differ from the double one (see pip_contains_banded())
+
+namespace URBAN3D
+{
+
+// Rings of a polygon, as seen by the kernels
+enum RingLayout : uint8_t
+{
+    SINGLE_RING,  // one ring
+    WITH_HOLES,   // one exterior ring, all the other rings are holes inside it
+    MULTIPART     // any set of rings (several parts, islands inside holes, ...)
+};
+
+// Rings [ring_begin, ring_end) of a CSR polygon set: ring r spans the vertices
+// [ring_offsets[r], ring_offsets[r+1]). For WITH_HOLES, outer is the exterior ring.
+template<class T>
+struct PolygonRings
+{
+    const T        *xs, *ys;
+    const uint64_t *ring_offsets;
+    uint64_t        ring_begin, ring_end;
+    uint64_t        outer;
+};
+
+// The horizontal ray from (x,y) towards +x crosses the edge (xi,yi)-(xj,yj)
+template<class T>
+struct Crossing
+{
+    static bool test (const T xi, const T yi, const T xj, const T yj, const T x, const T y)
+    {
+        // no branch: on horizontal edges the abscissa is not finite, and not used
+        return ((yi > y) != (yj > y)) & (x < (xj - xi) * (y - yi) / (yj - yi) + xi);
+    }
+};
+
+// crossing parity of (x,y) over the edges of ring r
+template<class T>
+bool ring_parity (const PolygonRings<T> &p, const uint64_t r, const T x, const T y)
+{
+    const uint64_t begin = p.ring_offsets[r];
+    const uint64_t end   = p.ring_offsets[r+1];
+
+    bool c = false;
+
+    for (uint64_t i = begin, j = end - 1; i < end; j = i++)
+        if (Crossing<T>::test(p.xs[i], p.ys[i], p.xs[j], p.ys[j], x, y))
+            c = !c;
+
+    return c;
+}
+
+// (x,y) lies in the polygon
+template<class T, RingLayout L>
+bool pip_contains (const PolygonRings<T> &p, const T x, const T y)
+{
+    if constexpr (L == SINGLE_RING)
+    {
+        return ring_parity(p, p.ring_begin, x, y);
+    }
+    else if constexpr (L == WITH_HOLES)
+    {
+        // outside the exterior ring: outside all the holes too
+        if (!ring_parity(p, p.outer, x, y))
+            return false;
+
+        for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+            if (r != p.outer && ring_parity(p, r, x, y))
+                return false;
+
+        return true;
+    }
+    else
+    {
+        bool c = false;
+
+        for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+            c ^= ring_parity(p, r, x, y);
+
+        return c;
+    }
+}
+
+// crossing parity of n points over the edges of ring r, edge by edge: every edge is
+// tested against all the points before moving to the next one
+template<class T>
+void ring_parity (const PolygonRings<T> &p, const uint64_t r, const T *px, const T *py, const size_t n, uint8_t *inside)
+{
+    const uint64_t begin = p.ring_offsets[r];
+    const uint64_t end   = p.ring_offsets[r+1];
+
+    for (uint64_t i = begin, j = end - 1; i < end; j = i++)
+    {
+        const T xi = p.xs[i], yi = p.ys[i];
+        const T xj = p.xs[j], yj = p.ys[j];
+
+        for (size_t k = 0; k < n; k++)
+            inside[k] ^= Crossing<T>::test(xi, yi, xj, yj, px[k], py[k]);
+    }
+}
+
+// inside[k] = 1 if (px[k],py[k]) lies in the polygon, 0 otherwise
+template<class T, RingLayout L>
+void pip_contains (const PolygonRings<T> &p, const T *px, const T *py, const size_t n, uint8_t *inside)
+{
+    for (size_t k = 0; k < n; k++)
+        inside[k] = 0;
+
+    if constexpr (L == SINGLE_RING)
+    {
+        ring_parity(p, p.ring_begin, px, py, n, inside);
+    }
+    else if constexpr (L == WITH_HOLES)
+    {
+        ring_parity(p, p.outer, px, py, n, inside);
+
+        // no point in the exterior ring: none in the polygon
+        uint8_t any = 0;
+        for (size_t k = 0; k < n; k++)
+            any |= inside[k];
+
+        if (!any)
+            return;
+
+        for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+            if (r != p.outer)
+                ring_parity(p, r, px, py, n, inside);
+    }
+    else
+    {
+        for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+            ring_parity(p, r, px, py, n, inside);
+    }
+}
+
+// Tolerances of the banded test of polygons (and points) within a box of the given
+// extent around the local origin, for float coordinates: the rounding errors of the
+// coordinates and of the side test stay well below them
+template<class T>
+struct CrossingBand
+{
+    T dy;    // points closer than this to the Y of a vertex are unsure
+    T side;  // and those with a side test (cross product) smaller than this
+
+    explicit CrossingBand (const double extent)
+        : dy(T(std::ldexp(extent, -18))), side(T(std::ldexp(extent * extent, -16))) {}
+};
+
+// As the edge-major pip_contains(), in reduced precision: unsure[k] is set to 1 for the
+// points too close to a vertex Y or to an edge for the answer to be trusted (they must
+// be tested again in full precision), and left unchanged for the others. The side test
+// is a cross product rather than the intersection abscissa, so that its error does
+// not grow on nearly horizontal edges.
+template<class T, RingLayout L>
+void pip_contains_banded (const PolygonRings<T> &p, const T *px, const T *py, const size_t n,
+                          const CrossingBand<T> &band, uint8_t *inside, uint8_t *unsure)
+{
+    for (size_t k = 0; k < n; k++)
+        inside[k] = 0;
+
+    auto ring = [&](const uint64_t r)
+    {
+        const uint64_t begin = p.ring_offsets[r];
+        const uint64_t end   = p.ring_offsets[r+1];
+
+        for (uint64_t i = begin, j = end - 1; i < end; j = i++)
+        {
+            const T xi = p.xs[i], yi = p.ys[i];
+            const T xj = p.xs[j], yj = p.ys[j];
+            const T dx = xj - xi, dy = yj - yi;
+            const bool up = dy > 0;
+
+            for (size_t k = 0; k < n; k++)
+            {
+                const T    ry    = py[k] - yi;
+                const T    side  = (px[k] - xi) * dy - dx * ry;
+                const bool cross = (yi > py[k]) != (yj > py[k]);
+
+                inside[k] ^= cross & ((side < 0) == up);
+                unsure[k] |= (std::fabs(ry) <= band.dy) | (cross & (std::fabs(side) <= band.side));
+            }
+        }
+    };
+
+    if constexpr (L == SINGLE_RING)
+    {
+        ring(p.ring_begin);
+    }
+    else if constexpr (L == WITH_HOLES)
+    {
+        ring(p.outer);
+
+        for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+            if (r != p.outer)
+                ring(r);
+    }
+    else
+    {
+        for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+            ring(r);
+    }
+}
+
+}
+
+#endif // PIP_KERNEL_H
@@ -0,0 +1,32 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef PIP_PARTITION_H
+#define PIP_PARTITION_H
+
+// Public API of the pip_partition library:
+//
+//   URBAN3D::PolygonSet polys;
+//   URBAN3D::load_shapefile("regions.shp", polys);   // prepared on return
+//
+//   std::vector<uint> point2region (n);
+//   URBAN3D::classify(polys, x, y, n, point2region.data());
+
+#include "polygon_set.h"
+#include "mesh_locator.h"
+#include "segment_grid.h"
+#include "point_grid.h"
+#include "classifier.h"
+#include "tiled_partition.h"
+#include "shard.h"
+#include "incremental.h"
+#include "../io/filter_LAS.h"
+#include "../io/read_LAS.h"
+#include "../io/write_LAS.h"
+#include "../utils/profiler.h"
+
+#endif // PIP_PARTITION_H
@@ -0,0 +1,93 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "point_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+void PointGrid::build (const double *x, const double *y, const size_t n, const double points_per_cell)
+{
+    extent = BBox2();
+    cell_offsets.clear();
+    cell_points.clear();
+    nx = ny = 0;
+
+    for (size_t j = 0; j < n; j++)
+        extent.add(x[j], y[j]);
+
+    if (extent.empty())
+        return;
+
+    double w = std::max(extent.xmax - extent.xmin, 1e-9);
+    double h = std::max(extent.ymax - extent.ymin, 1e-9);
+
+    double n_cells = std::max(1.0, std::min(double(n) / points_per_cell, 1e8));
+
+    nx = std::max(1u, uint(std::ceil(std::sqrt(n_cells * w / h))));
+    ny = std::max(1u, uint(std::ceil(n_cells / nx)));
+
+    cell_w = w / nx;
+    cell_h = h / ny;
+
+    // counting sort of the points by cell
+    std::vector<uint> point_cell (n);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t j = 0; j < (int64_t) n; j++)
+    {
+        uint cx = std::min(nx-1, uint((x[j] - extent.xmin) / cell_w));
+        uint cy = std::min(ny-1, uint((y[j] - extent.ymin) / cell_h));
+        point_cell[j] = uint(size_t(cy) * nx + cx);
+    }
+
+    cell_offsets.assign(size_t(nx) * ny + 1, 0);
+
+    for (size_t j = 0; j < n; j++)
+        cell_offsets[point_cell[j] + 1]++;
+
+    for (size_t c = 1; c < cell_offsets.size(); c++)
+        cell_offsets[c] += cell_offsets[c-1];
+
+    cell_points.resize(n);
+
+    std::vector<uint64_t> fill (cell_offsets.begin(), cell_offsets.end()-1);
+
+    for (size_t j = 0; j < n; j++)
+        cell_points[fill[point_cell[j]]++] = uint(j);
+}
+
+PIP_INLINE
+bool PointGrid::cell_range (const BBox2 &b, uint &cx0, uint &cy0, uint &cx1, uint &cy1) const
+{
+    if (empty() || b.empty() || !b.overlaps(extent))
+        return false;
+
+    cx0 = std::min(nx-1, uint(std::max(0.0, (b.xmin - extent.xmin) / cell_w)));
+    cy0 = std::min(ny-1, uint(std::max(0.0, (b.ymin - extent.ymin) / cell_h)));
+    cx1 = std::min(nx-1, uint(std::max(0.0, (b.xmax - extent.xmin) / cell_w)));
+    cy1 = std::min(ny-1, uint(std::max(0.0, (b.ymax - extent.ymin) / cell_h)));
+
+    return true;
+}
+
+PIP_INLINE
+BBox2 PointGrid::cell_bbox (const uint cx, const uint cy) const
+{
+    BBox2 b;
+    b.xmin = extent.xmin + cx * cell_w;
+    b.ymin = extent.ymin + cy * cell_h;
+    b.xmax = b.xmin + cell_w;
+    b.ymax = b.ymin + cell_h;
+    return b;
+}
+
+}
@@ -0,0 +1,67 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef POINT_GRID_H
+#define POINT_GRID_H
+
+#include "../utils/pip_inline.h"
+#include "region_grid.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Uniform grid over a set of points (at most POINT_CHUNK of them, see PointIds).
+// Each cell lists (in increasing order) the points falling in it, stored in CSR form:
+// the points of cell c are cell_points[cell_offsets[c] .. cell_offsets[c+1]).
+class PointGrid
+{
+private:
+
+    BBox2 extent;
+    double cell_w = 1.0;
+    double cell_h = 1.0;
+    uint nx = 0;
+    uint ny = 0;
+
+    std::vector<uint64_t> cell_offsets;
+    std::vector<uint>     cell_points;
+
+public:
+
+    void build (const double *x, const double *y, const size_t n, const double points_per_cell = 32.0);
+
+    bool empty () const { return cell_offsets.empty(); }
+
+    uint num_cells_x () const { return nx; }
+    uint num_cells_y () const { return ny; }
+    const BBox2 & get_extent () const { return extent; }
+
+    double get_cell_w () const { return cell_w; }
+    double get_cell_h () const { return cell_h; }
+
+    // cells [cx0, cx1] x [cy0, cy1] overlapping b, false if none
+    bool cell_range (const BBox2 &b, uint &cx0, uint &cy0, uint &cx1, uint &cy1) const;
+
+    BBox2 cell_bbox (const uint cx, const uint cy) const;
+
+    GISSpan<const uint> points (const uint cx, const uint cy) const
+    {
+        const size_t c = size_t(cy) * nx + cx;
+        return GISSpan<const uint>(cell_points.data() + cell_offsets[c], cell_offsets[c+1] - cell_offsets[c]);
+    }
+};
+
+}
+
+#ifndef static_lib
+#include "point_grid.cpp"
+#endif
+
+#endif // POINT_GRID_H
@@ -0,0 +1,787 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "polygon_set.h"
+#include "../utils/profiler.h"
+
+#include <shapefil.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+void PolygonSet::clear ()
+{
+    xs.clear();
+    ys.clear();
+    ring_offsets.assign(1, 0);
+    poly_offsets.assign(1, 0);
+    bboxes.clear();
+    areas.clear();
+    grid = RegionGrid();
+    inner_boxes.clear();
+    inner_offsets.assign(1, 0);
+    zmins.clear();
+    zmaxs.clear();
+    layouts.clear();
+    outer_rings.clear();
+    fxs.clear();
+    fys.clear();
+}
+
+PIP_INLINE
+void PolygonSet::begin_polygon ()
+{
+    poly_offsets.push_back(poly_offsets.back());
+    bboxes.push_back(BBox2());
+}
+
+PIP_INLINE
+void PolygonSet::add_ring (const double *x, const double *y, const size_t n)
+{
+    xs.insert(xs.end(), x, x + n);
+    ys.insert(ys.end(), y, y + n);
+
+    for (size_t i=0; i < n; i++)
+        bboxes.back().add(x[i], y[i]);
+
+    ring_offsets.push_back(xs.size());
+    poly_offsets.back()++;
+}
+
+PIP_INLINE
+void PolygonSet::set_z_bounds (const std::vector<double> &zmin, const std::vector<double> &zmax)
+{
+    zmins = zmin;
+    zmaxs = zmax;
+
+    zmins.resize(num_polygons(), -DBL_MAX);
+    zmaxs.resize(num_polygons(),  DBL_MAX);
+}
+
+// at most this many edge pairs are tested to tell a polygon WITH_HOLES; beyond it, MULTIPART
+const uint64_t LAYOUT_MAX_EDGE_PAIRS = uint64_t(1) << 24;
+
+// closed segments (ax,ay)-(bx,by) and (cx,cy)-(dx,dy) share a point (touching included)
+PIP_INLINE
+bool segments_meet (const double ax, const double ay, const double bx, const double by,
+                    const double cx, const double cy, const double dx, const double dy)
+{
+    if (std::max(ax, bx) < std::min(cx, dx) || std::max(cx, dx) < std::min(ax, bx) ||
+        std::max(ay, by) < std::min(cy, dy) || std::max(cy, dy) < std::min(ay, by))
+        return false;
+
+    auto side = [](const double x0, const double y0, const double x1, const double y1, const double x, const double y)
+    {
+        return (x1 - x0) * (y - y0) - (y1 - y0) * (x - x0);
+    };
+
+    const double s0 = side(cx, cy, dx, dy, ax, ay), s1 = side(cx, cy, dx, dy, bx, by);
+    const double s2 = side(ax, ay, bx, by, cx, cy), s3 = side(ax, ay, bx, by, dx, dy);
+
+    return !((s0 > 0 && s1 > 0) || (s0 < 0 && s1 < 0) || (s2 > 0 && s3 > 0) || (s2 < 0 && s3 < 0));
+}
+
+// some edge of ring r meets some edge of ring s. Each edge pair tested is taken from budget:
+// once it is spent, the rings are assumed to meet
+PIP_INLINE
+bool rings_meet (const PolygonRings<double> &p, const uint64_t r, const uint64_t s, const BBox2 &bs, uint64_t &budget)
+{
+    const uint64_t r_begin = p.ring_offsets[r], r_end = p.ring_offsets[r+1];
+    const uint64_t s_begin = p.ring_offsets[s], s_end = p.ring_offsets[s+1];
+
+    for (uint64_t i = r_begin, j = r_end - 1; i < r_end; j = i++)
+    {
+        BBox2 e;
+        e.add(p.xs[i], p.ys[i]);
+        e.add(p.xs[j], p.ys[j]);
+
+        if (!e.overlaps(bs))
+            continue;
+
+        if (budget < s_end - s_begin)
+            return true;
+
+        budget -= s_end - s_begin;
+
+        for (uint64_t k = s_begin, l = s_end - 1; k < s_end; l = k++)
+            if (segments_meet(p.xs[i], p.ys[i], p.xs[j], p.ys[j], p.xs[k], p.ys[k], p.xs[l], p.ys[l]))
+                return true;
+    }
+
+    return false;
+}
+
+// n_outer: number of rings of polygon pid that are not holes
+PIP_INLINE
+RingLayout PolygonSet::select_layout (const size_t pid, const uint n_outer) const
+{
+    if (poly_offsets[pid+1] - poly_offsets[pid] == 1)
+        return SINGLE_RING;
+
+    if (n_outer != 1)
+        return MULTIPART;
+
+    // the exterior ring may be tested first, and a point rejected by the first hole
+    // containing it, only if the holes lie inside the exterior ring and are disjoint:
+    // no edge of a hole meets the exterior ring or another hole, and no hole is inside another
+    PolygonRings<double> p = rings(pid, xs.data(), ys.data());
+
+    std::vector<BBox2> ring_boxes (p.ring_end - p.ring_begin);
+
+    for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+        for (uint64_t i = ring_offsets[r]; i < ring_offsets[r+1]; i++)
+            ring_boxes[r - p.ring_begin].add(xs[i], ys[i]);
+
+    const BBox2 &outer_box = ring_boxes[p.outer - p.ring_begin];
+
+    uint64_t budget = LAYOUT_MAX_EDGE_PAIRS;
+
+    for (uint64_t r = p.ring_begin; r < p.ring_end; r++)
+    {
+        if (r == p.outer)
+            continue;
+
+        for (uint64_t i = ring_offsets[r]; i < ring_offsets[r+1]; i++)
+            if (!ring_parity(p, p.outer, xs[i], ys[i]))
+                return MULTIPART;
+
+        if (rings_meet(p, r, p.outer, outer_box, budget))
+            return MULTIPART;
+
+        const BBox2 &br = ring_boxes[r - p.ring_begin];
+
+        for (uint64_t s = r + 1; s < p.ring_end; s++)
+        {
+            const BBox2 &bs = ring_boxes[s - p.ring_begin];
+
+            if (s == p.outer || !br.overlaps(bs))
+                continue;
+
+            if (rings_meet(p, r, s, bs, budget))
+                return MULTIPART;
+
+            // with no edges meeting, a ring nested in the other has all its vertices inside it
+            if (ring_parity(p, s, xs[ring_offsets[r]], ys[ring_offsets[r]]) ||
+                ring_parity(p, r, xs[ring_offsets[s]], ys[ring_offsets[s]]))
+                return MULTIPART;
+        }
+    }
+
+    return WITH_HOLES;
+}
+
+PIP_INLINE
+void PolygonSet::prepare (const double regions_per_cell)
+{
+    grid.build(bboxes, regions_per_cell);
+
+    areas.assign(num_polygons(), 0.0);
+    layouts.assign(num_polygons(), MULTIPART);
+    outer_rings.assign(num_polygons(), 0);
+    fxs.resize(xs.size());
+    fys.resize(ys.size());
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t pid = 0; pid < (int64_t) num_polygons(); pid++)
+    {
+        uint n_outer = 0;
+
+        for (uint64_t r = poly_offsets[pid]; r < poly_offsets[pid+1]; r++)
+        {
+            uint64_t begin = ring_offsets[r];
+            uint64_t end   = ring_offsets[r+1];
+
+            for (uint64_t i = begin; i < end; i++)
+            {
+                fxs[i] = float(xs[i] - bboxes[pid].xmin);
+                fys[i] = float(ys[i] - bboxes[pid].ymin);
+            }
+
+            if (begin == end)
+                continue;
+
+            double a = 0.0;
+            for (uint64_t i = begin, j = end - 1; i < end; j = i++)
+                a += (xs[j] - xs[i]) * (ys[j] + ys[i]);
+
+            // rings nested in an odd number of other rings are holes
+            bool hole = false;
+
+            for (uint64_t r2 = poly_offsets[pid]; r2 < poly_offsets[pid+1]; r2++)
+            {
+                if (r2 == r) continue;
+
+                for (uint64_t i = ring_offsets[r2], j = ring_offsets[r2+1] - 1; i < ring_offsets[r2+1]; j = i++)
+                {
+                    if (((ys[i] > ys[begin]) != (ys[j] > ys[begin])) &&
+                        (xs[begin] < (xs[j] - xs[i]) * (ys[begin] - ys[i]) / (ys[j] - ys[i]) + xs[i]))
+                        hole = !hole;
+                }
+            }
+
+            areas[pid] += (hole ? -0.5 : 0.5) * std::fabs(a);
+
+            if (!hole)
+            {
+                n_outer++;
+                outer_rings[pid] = r;
+            }
+        }
+
+        layouts[pid] = select_layout(pid, n_outer);
+    }
+
+    std::vector<std::vector<BBox2>> boxes (num_polygons());
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t pid = 0; pid < (int64_t) num_polygons(); pid++)
+        compute_inner_boxes(pid, boxes[pid]);
+
+    inner_boxes.clear();
+    inner_offsets.assign(1, 0);
+
+    for (const std::vector<BBox2> &b : boxes)
+    {
+        inner_boxes.insert(inner_boxes.end(), b.begin(), b.end());
+        inner_offsets.push_back(inner_boxes.size());
+    }
+}
+
+// resolution of the raster of a polygon bbox used to find its inner boxes
+const uint INNER_GRID = 16;
+
+// at most this many inner boxes per polygon, each of at least INNER_MIN_CELLS raster cells
+const uint INNER_MAX_BOXES = 4;
+const uint INNER_MIN_CELLS = 4;
+
+// segment (ax,ay)-(bx,by) intersects the closed rectangle b (Liang-Barsky clipping)
+PIP_INLINE
+bool segment_hits_box (const double ax, const double ay, const double bx, const double by, const BBox2 &b)
+{
+    const double p[4] = {ax - bx, bx - ax, ay - by, by - ay};
+    const double q[4] = {ax - b.xmin, b.xmax - ax, ay - b.ymin, b.ymax - ay};
+
+    double t0 = 0.0, t1 = 1.0;
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (p[k] == 0.0)
+        {
+            if (q[k] < 0.0) return false;
+            continue;
+        }
+
+        double t = q[k] / p[k];
+
+        if (p[k] < 0.0) { if (t > t1) return false; t0 = std::max(t0, t); }
+        else            { if (t < t0) return false; t1 = std::min(t1, t); }
+    }
+
+    return true;
+}
+
+// The bbox is rasterized in INNER_GRID x INNER_GRID cells. A cell is inside if no edge
+// touches it (grown by a small tolerance) and its center passes the crossing test: the
+// crossing parity cannot change within the cell, so all of its points are inside.
+// Inner boxes are then the largest rectangles of inside cells, taken greedily.
+PIP_INLINE
+void PolygonSet::compute_inner_boxes (const size_t pid, std::vector<BBox2> &boxes) const
+{
+    boxes.clear();
+
+    const BBox2 &bb = bboxes[pid];
+
+    if (bb.empty() || bb.xmax <= bb.xmin || bb.ymax <= bb.ymin)
+        return;
+
+    const uint   G   = INNER_GRID;
+    const double cw  = (bb.xmax - bb.xmin) / G;
+    const double ch  = (bb.ymax - bb.ymin) / G;
+    const double eps = 1e-9 * std::max(bb.xmax - bb.xmin, bb.ymax - bb.ymin);
+
+    auto cell_box = [&](const uint cx0, const uint cy0, const uint cx1, const uint cy1)
+    {
+        BBox2 b;
+        b.xmin = bb.xmin + cx0 * cw;  b.xmax = bb.xmin + cx1 * cw;
+        b.ymin = bb.ymin + cy0 * ch;  b.ymax = bb.ymin + cy1 * ch;
+        return b;
+    };
+
+    auto cell_of = [&](const double v, const double vmin, const double step)
+    {
+        return uint(std::clamp((v - vmin) / step, 0.0, double(G - 1)));
+    };
+
+    // cells touched by an edge
+    std::vector<uint8_t> inside (G * G, 1);
+
+    for (uint64_t r = poly_offsets[pid]; r < poly_offsets[pid+1]; r++)
+    {
+        for (uint64_t i = ring_offsets[r], j = ring_offsets[r+1] - 1; i < ring_offsets[r+1]; j = i++)
+        {
+            uint cx0 = cell_of(std::min(xs[i], xs[j]) - eps, bb.xmin, cw), cx1 = cell_of(std::max(xs[i], xs[j]) + eps, bb.xmin, cw);
+            uint cy0 = cell_of(std::min(ys[i], ys[j]) - eps, bb.ymin, ch), cy1 = cell_of(std::max(ys[i], ys[j]) + eps, bb.ymin, ch);
+
+            for (uint cy = cy0; cy <= cy1; cy++)
+            {
+                for (uint cx = cx0; cx <= cx1; cx++)
+                {
+                    BBox2 c = cell_box(cx, cy, cx+1, cy+1);
+                    c.xmin -= eps; c.xmax += eps;
+                    c.ymin -= eps; c.ymax += eps;
+
+                    if (inside[cy * G + cx] && segment_hits_box(xs[i], ys[i], xs[j], ys[j], c))
+                        inside[cy * G + cx] = 0;
+                }
+            }
+        }
+    }
+
+    // crossing test of the cell centers, one row at a time
+    std::vector<double> crossings;
+
+    for (uint cy = 0; cy < G; cy++)
+    {
+        const double y = bb.ymin + (cy + 0.5) * ch;
+
+        crossings.clear();
+
+        for (uint64_t r = poly_offsets[pid]; r < poly_offsets[pid+1]; r++)
+            for (uint64_t i = ring_offsets[r], j = ring_offsets[r+1] - 1; i < ring_offsets[r+1]; j = i++)
+                if ((ys[i] > y) != (ys[j] > y))
+                    crossings.push_back((xs[j] - xs[i]) * (y - ys[i]) / (ys[j] - ys[i]) + xs[i]);
+
+        std::sort(crossings.begin(), crossings.end());
+
+        // crossings right of the center: the center is inside if they are odd
+        size_t k = 0;
+
+        for (uint cx = 0; cx < G; cx++)
+        {
+            const double x = bb.xmin + (cx + 0.5) * cw;
+
+            while (k < crossings.size() && crossings[k] <= x)
+                k++;
+
+            if ((crossings.size() - k) % 2 == 0)
+                inside[cy * G + cx] = 0;
+        }
+    }
+
+    // largest rectangles of inside cells (row by row histograms of the inside runs)
+    std::vector<uint> height (G);
+    std::vector<uint> stack;
+
+    while (boxes.size() < INNER_MAX_BOXES)
+    {
+        uint best = 0, bx0 = 0, by0 = 0, bx1 = 0, by1 = 0;
+
+        std::fill(height.begin(), height.end(), 0);
+
+        for (uint cy = 0; cy < G; cy++)
+        {
+            for (uint cx = 0; cx < G; cx++)
+                height[cx] = inside[cy * G + cx] ? height[cx] + 1 : 0;
+
+            stack.clear();
+
+            for (uint cx = 0; cx <= G; cx++)
+            {
+                uint h = (cx < G) ? height[cx] : 0;
+
+                while (!stack.empty() && height[stack.back()] >= h)
+                {
+                    uint top = stack.back();
+                    stack.pop_back();
+
+                    uint left = stack.empty() ? 0 : stack.back() + 1;
+                    uint area = height[top] * (cx - left);
+
+                    if (area > best)
+                    {
+                        best = area;
+                        bx0 = left;  bx1 = cx;
+                        by0 = cy + 1 - height[top];  by1 = cy + 1;
+                    }
+                }
+
+                stack.push_back(cx);
+            }
+        }
+
+        if (best < INNER_MIN_CELLS)
+            break;
+
+        boxes.push_back(cell_box(bx0, by0, bx1, by1));
+
+        for (uint cy = by0; cy < by1; cy++)
+            for (uint cx = bx0; cx < bx1; cx++)
+                inside[cy * G + cx] = 0;
+    }
+}
+
+PIP_INLINE
+bool PolygonSet::contains (const uint pid, const double x, const double y, ContainsTally &tally) const
+{
+    PIP_COUNT(PNPOLY_CALLS, 1);
+
+    if (!bboxes[pid].contains(x, y))
+    {
+        PIP_COUNT(BBOX_REJECTIONS, 1);
+        return false;
+    }
+
+    if (quick_accept(pid, x, y))
+    {
+        PIP_COUNT(QUICK_ACCEPTS, 1);
+        tally.quick_accepts++;
+        return true;
+    }
+
+    PIP_COUNT(CROSSING_TESTS, 1);
+    tally.crossing_tests++;
+    PIP_COUNT(EDGES_TESTED, ring_offsets[poly_offsets[pid+1]] - ring_offsets[poly_offsets[pid]]);
+
+    const PolygonRings<double> p = rings(pid, xs.data(), ys.data());
+
+    switch (layouts[pid])
+    {
+        case SINGLE_RING: return pip_contains<double, SINGLE_RING>(p, x, y);
+        case WITH_HOLES:  return pip_contains<double, WITH_HOLES>(p, x, y);
+        default:          return pip_contains<double, MULTIPART>(p, x, y);
+    }
+}
+
+// smallest batch worth converting to float coordinates
+const size_t FLOAT_MIN_BATCH = 32;
+
+template<RingLayout L>
+void contains_batch (const PolygonRings<double> &p, const PolygonRings<float> &pf, const BBox2 &b,
+                     const double *px, const double *py, const size_t n, uint8_t *inside)
+{
+    if (n < FLOAT_MIN_BATCH || !(b.xmax > b.xmin || b.ymax > b.ymin))
+    {
+        pip_contains<double, L>(p, px, py, n, inside);
+        return;
+    }
+
+    // per-thread scratch: points relative to the bbox corner, and the unsure ones
+    thread_local std::vector<float>   fx, fy;
+    thread_local std::vector<uint8_t> unsure;
+
+    fx.resize(n);
+    fy.resize(n);
+    unsure.resize(n);
+
+    for (size_t k = 0; k < n; k++)
+    {
+        fx[k] = float(px[k] - b.xmin);
+        fy[k] = float(py[k] - b.ymin);
+        unsure[k] = !b.contains(px[k], py[k]);
+    }
+
+    const CrossingBand<float> band (std::max(b.xmax - b.xmin, b.ymax - b.ymin));
+
+    pip_contains_banded<float, L>(pf, fx.data(), fy.data(), n, band, inside, unsure.data());
+
+    for (size_t k = 0; k < n; k++)
+        if (unsure[k])
+            inside[k] = pip_contains<double, L>(p, px[k], py[k]);
+}
+
+PIP_INLINE
+void PolygonSet::contains (const uint pid, const double *px, const double *py, const size_t n, uint8_t *inside) const
+{
+    PIP_COUNT(PNPOLY_CALLS, n);
+    PIP_COUNT(CROSSING_TESTS, n);
+    PIP_COUNT(EDGES_TESTED, (ring_offsets[poly_offsets[pid+1]] - ring_offsets[poly_offsets[pid]]) * n);
+
+    const PolygonRings<double> p  = rings(pid, xs.data(), ys.data());
+    const PolygonRings<float>  pf = rings(pid, fxs.data(), fys.data());
+
+    switch (layouts[pid])
+    {
+        case SINGLE_RING: contains_batch<SINGLE_RING>(p, pf, bboxes[pid], px, py, n, inside); break;
+        case WITH_HOLES:  contains_batch<WITH_HOLES>(p, pf, bboxes[pid], px, py, n, inside); break;
+        default:          contains_batch<MULTIPART>(p, pf, bboxes[pid], px, py, n, inside); break;
+    }
+}
+
+PIP_INLINE
+uint PolygonSet::locate (const double x, const double y, ContainsTally &tally) const
+{
+    GISSpan<const uint> candidates = grid.candidates(x, y);
+
+    PIP_COUNT(INDEX_CANDIDATES, candidates.size());
+
+    for (uint pid : candidates)
+        if (contains(pid, x, y, tally))
+            return pid;
+
+    return UINT_MAX;
+}
+
+PIP_INLINE
+bool load_shapefile (const std::string &filename, PolygonSet &polys)
+{
+    polys.clear();
+
+    SHPHandle hSHP = SHPOpen(filename.c_str(), "rb");
+
+    if (hSHP == nullptr)
+    {
+        std::cerr << "Error opening shapefile " << filename << std::endl;
+        return false;
+    }
+
+    int nShapeType, nRegions;
+    double adfBndsMin[4], adfBndsMax[4];
+
+    SHPGetInfo(hSHP, &nRegions, &nShapeType, adfBndsMin, adfBndsMax);
+
+    if ((nShapeType != SHPT_POLYGONZ) && (nShapeType != SHPT_POLYGON))
+    {
+        // Wrong type: must be polygons
+        std::cerr << "Unsupported polygon type." << std::endl;
+        SHPClose(hSHP);
+        return false;
+    }
+
+    for (int i = 0; i < nRegions; ++i)
+    {
+        SHPObject *region = SHPReadObject(hSHP, i);
+
+        polys.begin_polygon();
+
+        if (region == nullptr)
+            continue;
+
+        // shapefile parts are rings (exterior or holes)
+        for (int part = 0; part < region->nParts; part++)
+        {
+            int begin = region->panPartStart[part];
+            int end   = (part+1 < region->nParts) ? region->panPartStart[part+1] : region->nVertices;
+
+            polys.add_ring(region->padfX + begin, region->padfY + begin, end - begin);
+        }
+
+        SHPDestroyObject(region);
+    }
+
+    SHPClose(hSHP);
+
+    polys.prepare();
+
+    return true;
+}
+
+PIP_INLINE
+void load_polygons (const GISGeometryBuffer &layer, PolygonSet &polys)
+{
+    polys.clear();
+
+    std::vector<double> x, y;
+
+    for (size_t fid=0; fid < layer.num_features(); fid++)
+    {
+        polys.begin_polygon();
+
+        uint64_t ring_begin = layer.part_ring_begin(layer.feature_part_begin(fid));
+        uint64_t ring_end   = layer.part_ring_begin(layer.feature_part_end(fid));
+
+        for (uint64_t r=ring_begin; r < ring_end; r++)
+        {
+            x.clear();
+            y.clear();
+
+            for (const cinolib::vec3d &p : layer.ring(r))
+            {
+                x.push_back(p.x());
+                y.push_back(p.y());
+            }
+
+            polys.add_ring(x.data(), y.data(), x.size());
+        }
+    }
+
+    polys.prepare();
+}
+
+PIP_INLINE
+void load_polygons (const cinolib::Polygonmesh<> &m, PolygonSet &polys)
+{
+    polys.clear();
+
+    std::vector<double> x, y;
+
+    for (uint pid=0; pid < m.num_polys(); pid++)
+    {
+        x.clear();
+        y.clear();
+
+        for (uint vid : m.adj_p2v(pid))
+        {
+            x.push_back(m.vert(vid).x());
+            y.push_back(m.vert(vid).y());
+        }
+
+        polys.begin_polygon();
+        polys.add_ring(x.data(), y.data(), x.size());
+    }
+
+    polys.prepare();
+}
+
+PIP_INLINE
+bool load_shapefile_field (const std::string &filename, const std::string &field, std::vector<double> &values)
+{
+    DBFHandle hDBF = DBFOpen(filename.c_str(), "rb");
+
+    if (hDBF == nullptr)
+    {
+        std::cerr << "Error opening the attributes of shapefile " << filename << std::endl;
+        return false;
+    }
+
+    int fid = DBFGetFieldIndex(hDBF, field.c_str());
+
+    if (fid < 0)
+    {
+        std::cerr << "Field " << field << " not found in " << filename << std::endl;
+        DBFClose(hDBF);
+        return false;
+    }
+
+    values.resize(DBFGetRecordCount(hDBF));
+
+    for (int i = 0; i < int(values.size()); i++)
+        values.at(i) = DBFReadDoubleAttribute(hDBF, i, fid);
+
+    DBFClose(hDBF);
+
+    return true;
+}
+
+PIP_INLINE
+bool load_shapefile_z (const std::string &filename, std::vector<double> &zmin, std::vector<double> &zmax)
+{
+    SHPHandle hSHP = SHPOpen(filename.c_str(), "rb");
+
+    if (hSHP == nullptr)
+    {
+        std::cerr << "Error opening shapefile " << filename << std::endl;
+        return false;
+    }
+
+    int nShapeType, nRegions;
+    double adfBndsMin[4], adfBndsMax[4];
+
+    SHPGetInfo(hSHP, &nRegions, &nShapeType, adfBndsMin, adfBndsMax);
+
+    if (nShapeType != SHPT_POLYGONZ)
+        std::cerr << "Warning: " << filename << " has no vertex Z values" << std::endl;
+
+    zmin.assign(nRegions, 0.0);
+    zmax.assign(nRegions, 0.0);
+
+    for (int i = 0; i < nRegions; ++i)
+    {
+        SHPObject *region = SHPReadObject(hSHP, i);
+
+        if (region == nullptr)
+            continue;
+
+        if (region->nVertices > 0 && region->padfZ != nullptr)
+        {
+            zmin.at(i) = *std::min_element(region->padfZ, region->padfZ + region->nVertices);
+            zmax.at(i) = *std::max_element(region->padfZ, region->padfZ + region->nVertices);
+        }
+
+        SHPDestroyObject(region);
+    }
+
+    SHPClose(hSHP);
+
+    return true;
+}
+
+// one side of a prism specification: sum of numbers, attributes and z
+PIP_INLINE
+bool load_prism_side (const std::string &filename, const std::string &side, const std::vector<double> &vertex_z,
+                      const double unbounded, std::vector<double> &values)
+{
+    values.assign(vertex_z.size(), side.empty() ? unbounded : 0.0);
+
+    size_t begin = 0;
+
+    while (!side.empty() && begin <= side.size())
+    {
+        size_t end = std::min(side.find('+', begin), side.size());
+        std::string term = side.substr(begin, end - begin);
+        begin = end + 1;
+
+        if (term.empty())
+        {
+            std::cerr << "Invalid prism bound: " << side << std::endl;
+            return false;
+        }
+
+        std::vector<double> term_values;
+        char *parsed_end;
+        double number = std::strtod(term.c_str(), &parsed_end);
+
+        if (*parsed_end == '\0')
+            term_values.assign(values.size(), number);
+        else if (term == "z")
+            term_values = vertex_z;
+        else if (!load_shapefile_field(filename, term, term_values))
+            return false;
+
+        if (term_values.size() != values.size())
+        {
+            std::cerr << "The attribute table has " << term_values.size() << " records for "
+                      << values.size() << " shapes." << std::endl;
+            return false;
+        }
+
+        for (size_t i=0; i < values.size(); i++)
+            values.at(i) += term_values.at(i);
+    }
+
+    return true;
+}
+
+PIP_INLINE
+bool load_shapefile_z_bounds (const std::string &filename, const std::string &spec,
+                              std::vector<double> &zmin, std::vector<double> &zmax)
+{
+    size_t colon = spec.find(':');
+
+    if (colon == std::string::npos)
+    {
+        std::cerr << "Invalid prism bounds " << spec << ", expected <bottom>:<top>" << std::endl;
+        return false;
+    }
+
+    std::vector<double> vertex_zmin, vertex_zmax;
+
+    if (!load_shapefile_z(filename, vertex_zmin, vertex_zmax))
+        return false;
+
+    return load_prism_side(filename, spec.substr(0, colon), vertex_zmin, -DBL_MAX, zmin) &&
+           load_prism_side(filename, spec.substr(colon+1), vertex_zmax,  DBL_MAX, zmax);
+}
+
+}
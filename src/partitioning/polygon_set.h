@@ -0,0 +1,178 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef POLYGON_SET_H
+#define POLYGON_SET_H
+
+#include "../utils/pip_inline.h"
+#include "../io/gis_geometry.h"
+#include "region_grid.h"
+#include "pip_kernel.h"
+
+#include <cinolib/meshes/meshes.h>
+
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// How PolygonSet::contains() answered for the points within the bbox: accepted by an
+// inner box, or through the crossing test (for the quick-accept ratio of the profile)
+struct alignas(64) ContainsTally
+{
+    uint64_t quick_accepts  = 0;
+    uint64_t crossing_tests = 0;
+};
+
+// Set of regions prepared for point-in-polygon queries.
+// Vertices are stored as separate x/y arrays; each polygon is a range of rings
+// (exterior rings and holes, in any order: containment follows the even-odd rule),
+// each ring a range of vertices. prepare() computes the bounding boxes and the
+// region grid used to find the candidate polygons of a point, and a few rectangles
+// inside each polygon: points in one of them are accepted without any crossing test.
+// It also finds the ring layout of each polygon, which selects the crossing kernel
+// used for it (see pip_kernel.h), and a float copy of the vertices relative to the
+// bbox corner of their polygon, for the reduced precision kernels of batched queries.
+// Polygons may also have a Z range (set_z_bounds()): each region is then the vertical
+// prism over the polygon, and points outside its Z range are rejected before any XY test.
+class PolygonSet
+{
+private:
+
+    std::vector<double>   xs, ys;
+    std::vector<uint64_t> ring_offsets = {0}; // ring -> vertices
+    std::vector<uint64_t> poly_offsets = {0}; // polygon -> rings
+
+    std::vector<BBox2>  bboxes;
+    std::vector<double> areas;
+    RegionGrid grid;
+
+    std::vector<BBox2>    inner_boxes;          // rectangles inside the polygons
+    std::vector<uint64_t> inner_offsets = {0};  // polygon -> inner boxes
+
+    void compute_inner_boxes (const size_t pid, std::vector<BBox2> &boxes) const;
+
+    std::vector<double> zmins, zmaxs;  // prism bounds, empty if none
+
+    std::vector<RingLayout> layouts;     // polygon -> ring layout
+    std::vector<uint64_t>   outer_rings; // polygon -> exterior ring (WITH_HOLES only)
+    std::vector<float>      fxs, fys;    // vertices relative to the bbox corner of their polygon
+
+    RingLayout select_layout (const size_t pid, const uint n_outer) const;
+
+public:
+
+    void clear ();
+
+    void begin_polygon ();
+    void add_ring (const double *x, const double *y, const size_t n);
+
+    void prepare (const double regions_per_cell = 2.0);
+
+    size_t num_polygons () const { return poly_offsets.size()-1; }
+    size_t num_rings () const { return ring_offsets.size()-1; }
+    size_t num_vertices () const { return xs.size(); }
+
+    uint64_t poly_ring_begin (const size_t pid) const { return poly_offsets[pid]; }
+    uint64_t poly_ring_end   (const size_t pid) const { return poly_offsets[pid+1]; }
+    uint64_t ring_vert_begin (const size_t rid) const { return ring_offsets[rid]; }
+    uint64_t ring_vert_end   (const size_t rid) const { return ring_offsets[rid+1]; }
+
+    const double * get_xs () const { return xs.data(); }
+    const double * get_ys () const { return ys.data(); }
+
+    // area enclosed by the polygon (even-odd rule: holes and nested rings are accounted for),
+    // available after prepare()
+    double area (const size_t pid) const { return areas[pid]; }
+    const std::vector<double> & get_areas () const { return areas; }
+
+    const BBox2 & bbox (const size_t pid) const { return bboxes[pid]; }
+    const std::vector<BBox2> & get_bboxes () const { return bboxes; }
+    const RegionGrid & get_grid () const { return grid; }
+
+    // rectangles inside polygon pid (largest first), available after prepare()
+    GISSpan<const BBox2> inner (const size_t pid) const
+    {
+        return GISSpan<const BBox2>(inner_boxes.data() + inner_offsets[pid], inner_offsets[pid+1] - inner_offsets[pid]);
+    }
+
+    // (x,y) lies in an inner box of polygon pid, and thus in the polygon
+    bool quick_accept (const size_t pid, const double x, const double y) const
+    {
+        for (uint64_t k = inner_offsets[pid]; k < inner_offsets[pid+1]; k++)
+            if (inner_boxes[k].contains(x, y))
+                return true;
+
+        return false;
+    }
+
+    // one value per polygon (use -DBL_MAX / DBL_MAX for unbounded sides)
+    void set_z_bounds (const std::vector<double> &zmin, const std::vector<double> &zmax);
+
+    bool has_z_bounds () const { return !zmins.empty(); }
+
+    double z_min (const size_t pid) const { return zmins[pid]; }
+    double z_max (const size_t pid) const { return zmaxs[pid]; }
+
+    // z within the prism bounds of polygon pid (only meaningful if has_z_bounds())
+    bool in_z_range (const size_t pid, const double z) const { return (z >= zmins[pid]) & (z <= zmaxs[pid]); }
+
+    // ring layout of polygon pid, available after prepare()
+    RingLayout layout (const size_t pid) const { return layouts[pid]; }
+
+    // polygon pid as seen by the crossing kernels, over vertex arrays x, y indexed as get_xs()
+    // (e.g. the vertices converted to another coordinate type), available after prepare()
+    template<class T>
+    PolygonRings<T> rings (const size_t pid, const T *x, const T *y) const
+    {
+        return PolygonRings<T>{x, y, ring_offsets.data(), poly_offsets[pid], poly_offsets[pid+1], outer_rings[pid]};
+    }
+
+    // bbox test, inner boxes test, then crossing test over all the rings of the polygon
+    bool contains (const uint pid, const double x, const double y, ContainsTally &tally) const;
+    bool contains (const uint pid, const double x, const double y) const { ContainsTally t; return contains(pid, x, y, t); }
+
+    // first polygon (in id order) containing (x,y), UINT_MAX if none
+    uint locate (const double x, const double y, ContainsTally &tally) const;
+    uint locate (const double x, const double y) const { ContainsTally t; return locate(x, y, t); }
+
+    // crossing test of n points against polygon pid, edge by edge: every edge is
+    // tested against all the points before moving to the next one. No bbox or inner boxes test.
+    // inside[k] is set to 1 if (px[k],py[k]) lies in the polygon, to 0 otherwise.
+    // Batches of at least FLOAT_MIN_BATCH points go through the float kernel first; the
+    // points it is unsure about (and those outside the bbox) are then tested in double,
+    // so that the result is the same as the double kernel.
+    void contains (const uint pid, const double *px, const double *py, const size_t n, uint8_t *inside) const;
+};
+
+// Loaders: each feature/shape/cell becomes a polygon with the same id.
+// The set is prepared on return: call prepare() again only to change regions_per_cell.
+bool load_shapefile (const std::string &filename, PolygonSet &polys);
+void load_polygons (const GISGeometryBuffer &layer, PolygonSet &polys);
+void load_polygons (const cinolib::Polygonmesh<> &m, PolygonSet &polys);
+
+// Numeric attribute of each shape, from the DBF file of a shapefile
+bool load_shapefile_field (const std::string &filename, const std::string &field, std::vector<double> &values);
+
+// Min and max vertex Z of each shape of a shapefile (0 for shapes without Z)
+bool load_shapefile_z (const std::string &filename, std::vector<double> &zmin, std::vector<double> &zmax);
+
+// Prism bounds of the shapes of a shapefile, from a "<bottom>:<top>" specification.
+// Each side is a sum of terms, each of them a number, a numeric attribute, or z
+// (the min vertex Z of the shape for the bottom, the max for the top); an empty
+// side is unbounded. E.g. "z:z+height", "ground:eave", ":roof".
+bool load_shapefile_z_bounds (const std::string &filename, const std::string &spec,
+                              std::vector<double> &zmin, std::vector<double> &zmax);
+
+}
+
+#ifndef static_lib
+#include "polygon_set.cpp"
+#endif
+
+#endif // POLYGON_SET_H
@@ -0,0 +1,145 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "region_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+void BBox2::add (const double x, const double y)
+{
+    xmin = std::min(xmin, x);
+    ymin = std::min(ymin, y);
+    xmax = std::max(xmax, x);
+    ymax = std::max(ymax, y);
+}
+
+PIP_INLINE
+void BBox2::add (const BBox2 &b)
+{
+    if (b.empty()) return;
+
+    add(b.xmin, b.ymin);
+    add(b.xmax, b.ymax);
+}
+
+PIP_INLINE
+void RegionGrid::build (const std::vector<BBox2> &boxes, const double regions_per_cell)
+{
+    extent = BBox2();
+    cell_offsets.clear();
+    cell_regions.clear();
+    nx = ny = 0;
+
+    for (const BBox2 &b : boxes)
+        extent.add(b);
+
+    if (extent.empty())
+        return;
+
+    double w = std::max(extent.xmax - extent.xmin, 1e-9);
+    double h = std::max(extent.ymax - extent.ymin, 1e-9);
+
+    double n_cells = std::max(1.0, std::min(double(boxes.size()) / regions_per_cell, 1e8));
+
+    nx = std::max(1u, uint(std::ceil(std::sqrt(n_cells * w / h))));
+    ny = std::max(1u, uint(std::ceil(n_cells / nx)));
+
+    cell_w = w / nx;
+    cell_h = h / ny;
+
+    // two passes: count, prefix sum, fill
+    cell_offsets.assign(size_t(nx) * ny + 1, 0);
+
+    auto cell_range = [&](const BBox2 &b, uint &cx0, uint &cy0, uint &cx1, uint &cy1)
+    {
+        cx0 = std::min(nx-1, uint(std::max(0.0, (b.xmin - extent.xmin) / cell_w)));
+        cy0 = std::min(ny-1, uint(std::max(0.0, (b.ymin - extent.ymin) / cell_h)));
+        cx1 = std::min(nx-1, uint(std::max(0.0, (b.xmax - extent.xmin) / cell_w)));
+        cy1 = std::min(ny-1, uint(std::max(0.0, (b.ymax - extent.ymin) / cell_h)));
+    };
+
+    uint cx0, cy0, cx1, cy1;
+
+    for (const BBox2 &b : boxes)
+    {
+        if (b.empty()) continue;
+
+        cell_range(b, cx0, cy0, cx1, cy1);
+
+        for (uint cy=cy0; cy <= cy1; cy++)
+            for (uint cx=cx0; cx <= cx1; cx++)
+                cell_offsets.at(size_t(cy) * nx + cx + 1)++;
+    }
+
+    for (size_t c=1; c < cell_offsets.size(); c++)
+        cell_offsets.at(c) += cell_offsets.at(c-1);
+
+    cell_regions.resize(cell_offsets.back());
+
+    std::vector<uint64_t> fill (cell_offsets.begin(), cell_offsets.end()-1);
+
+    for (uint rid=0; rid < boxes.size(); rid++)
+    {
+        const BBox2 &b = boxes.at(rid);
+
+        if (b.empty()) continue;
+
+        cell_range(b, cx0, cy0, cx1, cy1);
+
+        for (uint cy=cy0; cy <= cy1; cy++)
+            for (uint cx=cx0; cx <= cx1; cx++)
+                cell_regions.at(fill.at(size_t(cy) * nx + cx)++) = rid;
+    }
+}
+
+PIP_INLINE
+bool RegionGrid::cell_of (const double x, const double y, uint &cx, uint &cy) const
+{
+    if (empty() || !extent.contains(x, y))
+        return false;
+
+    cx = std::min(nx-1, uint((x - extent.xmin) / cell_w));
+    cy = std::min(ny-1, uint((y - extent.ymin) / cell_h));
+
+    return true;
+}
+
+PIP_INLINE
+BBox2 RegionGrid::cell_bbox (const uint cx, const uint cy) const
+{
+    BBox2 b;
+    b.xmin = extent.xmin + cx * cell_w;
+    b.ymin = extent.ymin + cy * cell_h;
+    b.xmax = b.xmin + cell_w;
+    b.ymax = b.ymin + cell_h;
+    return b;
+}
+
+PIP_INLINE
+GISSpan<const uint> RegionGrid::cell_candidates (const uint cx, const uint cy) const
+{
+    size_t c = size_t(cy) * nx + cx;
+    return GISSpan<const uint>(cell_regions.data() + cell_offsets.at(c), cell_offsets.at(c+1) - cell_offsets.at(c));
+}
+
+PIP_INLINE
+GISSpan<const uint> RegionGrid::candidates (const double x, const double y) const
+{
+    uint cx, cy;
+
+    if (!cell_of(x, y, cx, cy))
+        return GISSpan<const uint>();
+
+    return cell_candidates(cx, cy);
+}
+
+}
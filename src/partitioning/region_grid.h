@@ -0,0 +1,88 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef REGION_GRID_H
+#define REGION_GRID_H
+
+#include "../utils/pip_inline.h"
+#include "../io/gis_geometry.h"
+
+#include <cfloat>
+#include <vector>
+
+namespace URBAN3D
+{
+
+class BBox2
+{
+public:
+
+    double xmin =  DBL_MAX;
+    double ymin =  DBL_MAX;
+    double xmax = -DBL_MAX;
+    double ymax = -DBL_MAX;
+
+    void add (const double x, const double y);
+    void add (const BBox2 &b);
+
+    bool empty () const { return xmin > xmax || ymin > ymax; }
+
+    bool contains (const double x, const double y) const
+    {
+        return x >= xmin && x <= xmax && y >= ymin && y <= ymax;
+    }
+
+    bool overlaps (const BBox2 &b) const
+    {
+        return xmin <= b.xmax && b.xmin <= xmax && ymin <= b.ymax && b.ymin <= ymax;
+    }
+};
+
+// Uniform grid over the bounding boxes of a set of regions.
+// Each cell lists (in increasing order) the regions whose bbox overlaps it,
+// stored in CSR form: the candidates of cell c are cell_regions[cell_offsets[c] .. cell_offsets[c+1]).
+class RegionGrid
+{
+private:
+
+    BBox2 extent;
+    double cell_w = 1.0;
+    double cell_h = 1.0;
+    uint nx = 0;
+    uint ny = 0;
+
+    std::vector<uint64_t> cell_offsets;
+    std::vector<uint>     cell_regions;
+
+public:
+
+    void build (const std::vector<BBox2> &boxes, const double regions_per_cell = 2.0);
+
+    bool empty () const { return cell_offsets.empty(); }
+
+    uint num_cells_x () const { return nx; }
+    uint num_cells_y () const { return ny; }
+    const BBox2 & get_extent () const { return extent; }
+
+    // false if (x,y) falls outside the grid
+    bool cell_of (const double x, const double y, uint &cx, uint &cy) const;
+
+    BBox2 cell_bbox (const uint cx, const uint cy) const;
+
+    GISSpan<const uint> cell_candidates (const uint cx, const uint cy) const;
+
+    // regions whose bbox may contain (x,y)
+    GISSpan<const uint> candidates (const double x, const double y) const;
+};
+
+}
+
+#ifndef static_lib
+#include "region_grid.cpp"
+#endif
+
+#endif // REGION_GRID_H
@@ -0,0 +1,251 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "segment_grid.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+void SegmentGrid::build (const PolygonSet &p, const double edges_per_cell)
+{
+    polys = &p;
+
+    edge_next.resize(p.num_vertices());
+    edge_poly.resize(p.num_vertices());
+
+    for (uint pid=0; pid < p.num_polygons(); pid++)
+    {
+        for (uint64_t r = p.poly_ring_begin(pid); r < p.poly_ring_end(pid); r++)
+        {
+            uint64_t begin = p.ring_vert_begin(r);
+            uint64_t end   = p.ring_vert_end(r);
+
+            for (uint64_t e = begin; e < end; e++)
+            {
+                edge_next.at(e) = (e+1 < end) ? e+1 : begin;
+                edge_poly.at(e) = pid;
+            }
+        }
+    }
+
+    extent = BBox2();
+    for (const BBox2 &b : p.get_bboxes())
+        extent.add(b);
+
+    cell_offsets.clear();
+    cell_edges.clear();
+    nx = ny = 0;
+
+    if (extent.empty())
+        return;
+
+    double w = std::max(extent.xmax - extent.xmin, 1e-9);
+    double h = std::max(extent.ymax - extent.ymin, 1e-9);
+
+    double n_cells = std::max(1.0, std::min(double(num_edges()) / edges_per_cell, 1e8));
+
+    nx = std::max(1u, uint(std::ceil(std::sqrt(n_cells * w / h))));
+    ny = std::max(1u, uint(std::ceil(n_cells / nx)));
+
+    cell_w = w / nx;
+    cell_h = h / ny;
+
+    const double *xs = p.get_xs();
+    const double *ys = p.get_ys();
+
+    auto cell_range = [&](const uint64_t e, uint &cx0, uint &cy0, uint &cx1, uint &cy1)
+    {
+        double x0 = std::min(xs[e], xs[edge_next[e]]), x1 = std::max(xs[e], xs[edge_next[e]]);
+        double y0 = std::min(ys[e], ys[edge_next[e]]), y1 = std::max(ys[e], ys[edge_next[e]]);
+
+        cx0 = std::min(nx-1, uint(std::max(0.0, (x0 - extent.xmin) / cell_w)));
+        cy0 = std::min(ny-1, uint(std::max(0.0, (y0 - extent.ymin) / cell_h)));
+        cx1 = std::min(nx-1, uint(std::max(0.0, (x1 - extent.xmin) / cell_w)));
+        cy1 = std::min(ny-1, uint(std::max(0.0, (y1 - extent.ymin) / cell_h)));
+    };
+
+    // two passes: count, prefix sum, fill
+    cell_offsets.assign(size_t(nx) * ny + 1, 0);
+
+    uint cx0, cy0, cx1, cy1;
+
+    for (uint64_t e=0; e < num_edges(); e++)
+    {
+        cell_range(e, cx0, cy0, cx1, cy1);
+
+        for (uint cy=cy0; cy <= cy1; cy++)
+            for (uint cx=cx0; cx <= cx1; cx++)
+                cell_offsets.at(size_t(cy) * nx + cx + 1)++;
+    }
+
+    for (size_t c=1; c < cell_offsets.size(); c++)
+        cell_offsets.at(c) += cell_offsets.at(c-1);
+
+    cell_edges.resize(cell_offsets.back());
+
+    std::vector<uint64_t> fill (cell_offsets.begin(), cell_offsets.end()-1);
+
+    for (uint64_t e=0; e < num_edges(); e++)
+    {
+        cell_range(e, cx0, cy0, cx1, cy1);
+
+        for (uint cy=cy0; cy <= cy1; cy++)
+            for (uint cx=cx0; cx <= cx1; cx++)
+                cell_edges.at(fill.at(size_t(cy) * nx + cx)++) = e;
+    }
+}
+
+PIP_INLINE
+double SegmentGrid::edge_distance (const uint64_t e, const double x, const double y) const
+{
+    const double *xs = polys->get_xs();
+    const double *ys = polys->get_ys();
+
+    double ax = xs[e], ay = ys[e];
+    double bx = xs[edge_next[e]], by = ys[edge_next[e]];
+
+    double dx = bx - ax, dy = by - ay;
+    double l2 = dx * dx + dy * dy;
+
+    // projection of the point on the edge, clamped to its endpoints
+    double t = (l2 > 0.0) ? std::clamp(((x - ax) * dx + (y - ay) * dy) / l2, 0.0, 1.0) : 0.0;
+
+    return std::hypot(x - (ax + t * dx), y - (ay + t * dy));
+}
+
+PIP_INLINE
+void SegmentGrid::polygons_within (const double x, const double y, const double d, std::vector<uint> &pids,
+                                   const double z) const
+{
+    pids.clear();
+
+    const bool prism = !std::isnan(z) && polys != nullptr && polys->has_z_bounds();
+
+    if (empty() || x + d < extent.xmin || x - d > extent.xmax || y + d < extent.ymin || y - d > extent.ymax)
+        return;
+
+    uint cx0 = std::min(nx-1, uint(std::max(0.0, (x - d - extent.xmin) / cell_w)));
+    uint cy0 = std::min(ny-1, uint(std::max(0.0, (y - d - extent.ymin) / cell_h)));
+    uint cx1 = std::min(nx-1, uint(std::max(0.0, (x + d - extent.xmin) / cell_w)));
+    uint cy1 = std::min(ny-1, uint(std::max(0.0, (y + d - extent.ymin) / cell_h)));
+
+    for (uint cy=cy0; cy <= cy1; cy++)
+    {
+        for (uint cx=cx0; cx <= cx1; cx++)
+        {
+            size_t c = size_t(cy) * nx + cx;
+
+            for (uint64_t k = cell_offsets[c]; k < cell_offsets[c+1]; k++)
+            {
+                uint64_t e = cell_edges[k];
+
+                // an edge in several cells, or a polygon already found
+                if (!pids.empty() && pids.back() == edge_poly[e])
+                    continue;
+
+                if (prism && !polys->in_z_range(edge_poly[e], z))
+                    continue;
+
+                if (edge_distance(e, x, y) <= d)
+                    pids.push_back(edge_poly[e]);
+            }
+        }
+    }
+
+    std::sort(pids.begin(), pids.end());
+    pids.erase(std::unique(pids.begin(), pids.end()), pids.end());
+}
+
+PIP_INLINE
+uint SegmentGrid::nearest_polygon (const double x, const double y, const double max_d, double &dist,
+                                   const double z) const
+{
+    uint best = UINT_MAX;
+    dist = max_d;
+
+    const bool prism = !std::isnan(z) && polys != nullptr && polys->has_z_bounds();
+
+    if (empty() || x + max_d < extent.xmin || x - max_d > extent.xmax || y + max_d < extent.ymin || y - max_d > extent.ymax)
+        return best;
+
+    // cell of the point, possibly outside the grid
+    const int64_t pcx = int64_t(std::floor((x - extent.xmin) / cell_w));
+    const int64_t pcy = int64_t(std::floor((y - extent.ymin) / cell_h));
+
+    const double  cell_min = std::min(cell_w, cell_h);
+    const int64_t max_ring = int64_t(std::ceil(max_d / cell_min)) + 1;
+
+    auto visit = [&](const int64_t cx, const int64_t cy)
+    {
+        if (cx < 0 || cy < 0 || cx >= nx || cy >= ny)
+            return;
+
+        // distance from the point to the cell
+        double x0 = extent.xmin + cx * cell_w, y0 = extent.ymin + cy * cell_h;
+        double dx = std::max({x0 - x, 0.0, x - (x0 + cell_w)});
+        double dy = std::max({y0 - y, 0.0, y - (y0 + cell_h)});
+
+        if (std::hypot(dx, dy) > dist)
+            return;
+
+        size_t c = size_t(cy) * nx + cx;
+
+        for (uint64_t k = cell_offsets[c]; k < cell_offsets[c+1]; k++)
+        {
+            uint64_t e = cell_edges[k];
+
+            if (prism && !polys->in_z_range(edge_poly[e], z))
+                continue;
+
+            double   d = edge_distance(e, x, y);
+
+            if (d < dist || (d == dist && edge_poly[e] < best))
+            {
+                dist = d;
+                best = edge_poly[e];
+            }
+        }
+    };
+
+    for (int64_t r = 0; r <= max_ring; r++)
+    {
+        // cells in ring r are at least (r-1) cells away from the point
+        if (r > 1 && (r-1) * cell_min > dist)
+            break;
+
+        for (int64_t cy = pcy - r; cy <= pcy + r; cy++)
+        {
+            if (cy == pcy - r || cy == pcy + r)
+            {
+                for (int64_t cx = pcx - r; cx <= pcx + r; cx++)
+                    visit(cx, cy);
+            }
+            else
+            {
+                visit(pcx - r, cy);
+                if (r > 0) visit(pcx + r, cy);
+            }
+        }
+
+        // the whole grid has been visited
+        if (pcx - r <= 0 && pcy - r <= 0 && pcx + r >= int64_t(nx) - 1 && pcy + r >= int64_t(ny) - 1)
+            break;
+    }
+
+    if (best == UINT_MAX)
+        dist = DBL_MAX;
+
+    return best;
+}
+
+}
@@ -0,0 +1,71 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef SEGMENT_GRID_H
+#define SEGMENT_GRID_H
+
+#include "../utils/pip_inline.h"
+#include "polygon_set.h"
+
+#include <cmath>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Uniform grid over the edges of a PolygonSet, for distance queries.
+// Edge e joins the vertices e and next(e) of its ring; each cell lists (CSR) the
+// edges whose bbox overlaps it.
+class SegmentGrid
+{
+private:
+
+    const PolygonSet *polys = nullptr;
+
+    std::vector<uint64_t> edge_next;   // second endpoint of each edge
+    std::vector<uint>     edge_poly;   // polygon of each edge
+
+    BBox2  extent;
+    double cell_w = 1.0;
+    double cell_h = 1.0;
+    uint   nx = 0;
+    uint   ny = 0;
+
+    std::vector<uint64_t> cell_offsets;
+    std::vector<uint64_t> cell_edges;
+
+public:
+
+    // polys must outlive the grid
+    void build (const PolygonSet &polys, const double edges_per_cell = 4.0);
+
+    bool empty () const { return cell_offsets.empty(); }
+
+    size_t num_edges () const { return edge_poly.size(); }
+
+    // distance between (x,y) and edge e
+    double edge_distance (const uint64_t e, const double x, const double y) const;
+
+    // polygons with an edge closer than d to (x,y), in increasing order.
+    // Unless z is NaN, only the polygons whose prism bounds contain z are considered.
+    void polygons_within (const double x, const double y, const double d, std::vector<uint> &pids,
+                          const double z = NAN) const;
+
+    // polygon with the edge nearest to (x,y) within max_d (ties: lowest id), UINT_MAX if none.
+    // Cells are visited in rings of increasing distance around the point, until no closer
+    // edge can be found. z as in polygons_within().
+    uint nearest_polygon (const double x, const double y, const double max_d, double &dist,
+                          const double z = NAN) const;
+};
+
+}
+
+#ifndef static_lib
+#include "segment_grid.cpp"
+#endif
+
+#endif // SEGMENT_GRID_H
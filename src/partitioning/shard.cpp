@@ -0,0 +1,226 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "shard.h"
+#include "../io/read_LAS.h"
+#include "../io/write_LAS.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+bool parse_shard (const std::string &s, ShardSpec &shard)
+{
+    size_t slash = s.find('/');
+
+    if (slash == std::string::npos)
+        return false;
+
+    try
+    {
+        long i = std::stol(s.substr(0, slash));
+        long n = std::stol(s.substr(slash+1));
+
+        if (n < 1 || i < 0 || i >= n)
+            return false;
+
+        shard.index = uint(i);
+        shard.count = uint(n);
+    }
+    catch (std::exception &)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+PIP_INLINE
+std::string shard_folder (const std::string &folder, const uint index)
+{
+    return folder + "/shard" + std::to_string(index);
+}
+
+PIP_INLINE
+bool mark_shard_done (const std::string &folder, const uint index)
+{
+    fs::create_directories(shard_folder(folder, index));
+
+    std::ofstream ofs (shard_folder(folder, index) + "/.done");
+    return ofs.is_open();
+}
+
+PIP_INLINE
+bool shard_done (const std::string &folder, const uint index)
+{
+    return fs::exists(shard_folder(folder, index) + "/.done");
+}
+
+PIP_INLINE
+std::string shell_quote (const std::string &arg)
+{
+    std::string quoted = "'";
+
+    for (char c : arg)
+    {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+
+    return quoted + "'";
+}
+
+PIP_INLINE
+bool run_local_shards (const std::string &command, const std::string &folder, const uint n_shards,
+                       const bool resume)
+{
+    std::vector<int> status (n_shards, 0);
+    std::vector<std::thread> workers;
+
+    // the shards share the threads of this process instead of each taking them all
+    const int n_threads = std::max(1, omp_get_max_threads() / int(std::max(n_shards, 1u)));
+
+    for (uint i=0; i < n_shards; i++)
+    {
+        if (resume && shard_done(folder, i))
+        {
+            std::cout << "Shard " << i << " already done, skipping" << std::endl;
+            continue;
+        }
+
+        std::string cmd = "OMP_NUM_THREADS=" + std::to_string(n_threads) + " " + command +
+                          " --shard " + std::to_string(i) + "/" + std::to_string(n_shards);
+
+        std::cout << "Launching shard " << i << ": " << cmd << std::endl;
+
+        workers.emplace_back([&status, cmd, i]() { status.at(i) = std::system(cmd.c_str()); });
+    }
+
+    for (std::thread &w : workers)
+        w.join();
+
+    bool ok = true;
+
+    for (uint i=0; i < n_shards; i++)
+    {
+        if (status.at(i) != 0)
+        {
+            std::cerr << "Shard " << i << " failed with status " << status.at(i) << std::endl;
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+// Writes the points of the existing files among inputs, in order, to filename
+PIP_INLINE
+bool concatenate_LAS (const std::vector<std::string> &inputs, const std::string &filename)
+{
+    liblas::Header header, input_header;
+    std::vector<liblas::Point> points, input_points;
+    std::vector<double> xs, ys;
+
+    bool found = false;
+
+    for (const std::string &input : inputs)
+    {
+        if (!fs::exists(input))
+            continue;
+
+        if (!read_LAS(input, input_header, input_points, xs, ys))
+            return false;
+
+        if (!found)
+        {
+            header = input_header;
+            found = true;
+        }
+
+        // points keep a pointer to the header they were read with
+        for (liblas::Point &p : input_points)
+        {
+            p.SetHeader(&header);
+            points.push_back(p);
+        }
+    }
+
+    if (!found)
+        return true;
+
+    return write_LAS(filename, header, points, PointIds::all(points.size()));
+}
+
+PIP_INLINE
+bool merge_shards (const std::string &folder, const uint n_shards)
+{
+    // regions written by at least one shard
+    std::set<uint> regions;
+
+    for (uint i=0; i < n_shards; i++)
+    {
+        fs::path sf = shard_folder(folder, i);
+
+        if (!shard_done(folder, i))
+        {
+            std::cerr << "Missing or incomplete shard output: " << sf.string() << std::endl;
+            return false;
+        }
+
+        for (const fs::directory_entry &e : fs::directory_iterator(sf))
+        {
+            std::string name = e.path().filename().string();
+
+            if (e.is_directory() && name.rfind("building", 0) == 0)
+                regions.insert(uint(std::stoul(name.substr(8))));
+        }
+    }
+
+    std::cout << "Merging " << regions.size() << " regions from " << n_shards << " shards" << std::endl;
+
+    for (uint pid : regions)
+    {
+        std::vector<std::string> inputs;
+
+        for (uint i=0; i < n_shards; i++)
+            inputs.push_back(region_LAS_path(shard_folder(folder, i), pid));
+
+        if (!concatenate_LAS(inputs, region_LAS_path(folder, pid)))
+            return false;
+    }
+
+    // points outside every region (nearest-region fallback)
+    std::vector<std::string> unassigned;
+
+    for (uint i=0; i < n_shards; i++)
+        unassigned.push_back(shard_folder(folder, i) + "/unassigned.las");
+
+    if (!concatenate_LAS(unassigned, folder + "/unassigned.las"))
+        return false;
+
+    for (uint i=0; i < n_shards; i++)
+        fs::remove_all(shard_folder(folder, i));
+
+    return true;
+}
+
+}
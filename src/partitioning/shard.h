@@ -0,0 +1,65 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "../utils/pip_inline.h"
+
+#include <string>
+
+namespace URBAN3D
+{
+
+// Shard index of count: the shard processes the points with index in
+// [index * n / count, (index+1) * n / count) and writes its regions to shard_folder()
+class ShardSpec
+{
+public:
+
+    uint index = 0;
+    uint count = 1;
+
+    bool sharded () const { return count > 1; }
+
+    size_t begin (const size_t n) const { return (n * index) / count; }
+    size_t end   (const size_t n) const { return (n * (index+1)) / count; }
+};
+
+// parses "i/N", with 0 <= i < N
+bool parse_shard (const std::string &s, ShardSpec &shard);
+
+// <folder>/shard<index>
+std::string shard_folder (const std::string &folder, const uint index);
+
+// Marks the output of a shard as complete (<folder>/shard<index>/.done)
+bool mark_shard_done (const std::string &folder, const uint index);
+bool shard_done (const std::string &folder, const uint index);
+
+// arg single-quoted for a POSIX shell (quotes in it escaped as '\'')
+std::string shell_quote (const std::string &arg);
+
+// Runs n_shards copies of command in parallel, appending "--shard i/N" to the i-th.
+// Each copy runs with OMP_NUM_THREADS set to its share of the OpenMP threads of the caller.
+// With resume set, shards whose output is complete are not run again.
+// Returns false if any of them fails.
+bool run_local_shards (const std::string &command, const std::string &folder, const uint n_shards,
+                       const bool resume = false);
+
+// Concatenates, for each region, the outputs of shards 0..n_shards-1 (in this order, all
+// of them complete)
+// into <folder>/building<pid>/<pid>.las, with point count and bounds of the merged
+// points, then removes the shard folders
+bool merge_shards (const std::string &folder, const uint n_shards);
+
+}
+
+#ifndef static_lib
+#include "shard.cpp"
+#endif
+
+#endif // SHARD_H
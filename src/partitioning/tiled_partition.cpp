@@ -0,0 +1,648 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#include "tiled_partition.h"
+#include "classifier.h"
+#include "region_grid.h"
+#include "segment_grid.h"
+#include "../io/read_LAS.h"
+#include "../io/write_LAS.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace URBAN3D
+{
+
+// tiles are written concurrently in pass 1, one open file each: keep them to at most
+// MAX_TILES and half the limit on open files of the process, leaving the rest to the
+// input cloud, unassigned.bin, the standard streams and the caller
+const size_t MAX_TILES = 1024;
+
+PIP_INLINE
+size_t max_open_tiles ()
+{
+    size_t limit = MAX_TILES;
+
+#if defined(__unix__) || defined(__APPLE__)
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+        limit = std::min(limit, size_t(rl.rlim_cur / 2));
+#else
+    limit = 256;
+#endif
+
+    return std::max(limit, size_t(1));
+}
+
+PIP_INLINE
+void TileGrid::build (const BBox2 &e, const size_t n_tiles)
+{
+    extent = e;
+
+    double w = std::max(extent.xmax - extent.xmin, 1e-9);
+    double h = std::max(extent.ymax - extent.ymin, 1e-9);
+
+    double n = std::max(1.0, double(n_tiles));
+
+    nx = std::max(1u, uint(std::min(n, std::ceil(std::sqrt(n * w / h)))));
+    ny = std::max(1u, uint(std::ceil(n / nx)));
+
+    tile_w = w / nx;
+    tile_h = h / ny;
+}
+
+PIP_INLINE
+uint TileGrid::tile_of (const double x, const double y) const
+{
+    uint cx = std::min(nx-1, uint(std::max(0.0, (x - extent.xmin) / tile_w)));
+    uint cy = std::min(ny-1, uint(std::max(0.0, (y - extent.ymin) / tile_h)));
+
+    return cy * nx + cx;
+}
+
+PIP_INLINE
+bool TilingManifest::read (const std::string &filename)
+{
+    std::ifstream ifs (filename);
+
+    if (!ifs.is_open())
+        return false;
+
+    std::string key;
+    size_t n_tiles = 0;
+
+    while (ifs >> key)
+    {
+        if      (key == "las_path")      { ifs >> std::ws; std::getline(ifs, las_path); }
+        else if (key == "las_size")      ifs >> las_size;
+        else if (key == "n_points")      ifs >> n_points;
+        else if (key == "n_regions")     ifs >> n_regions;
+        else if (key == "n_vertices")    ifs >> n_vertices;
+        else if (key == "memory_budget") ifs >> memory_budget;
+        else if (key == "policy")        ifs >> policy;
+        else if (key == "halo")          ifs >> halo;
+        else if (key == "nearest")       ifs >> nearest;
+        else if (key == "prism")         ifs >> prism;
+        else if (key == "filter")        { ifs >> std::ws; std::getline(ifs, filter); }
+        else if (key == "unassigned")    ifs >> unassigned_bytes;
+        else if (key == "tiles")
+        {
+            ifs >> nx >> ny;
+            n_tiles = size_t(nx) * ny;
+            tile_counts.assign(n_tiles, 0);
+            tile_done.assign(n_tiles, false);
+        }
+        else if (key == "binned")        ifs >> binned;
+        else if (key == "tile")
+        {
+            size_t t, count;
+            bool done;
+            ifs >> t >> count >> done;
+
+            if (t >= n_tiles)
+                return false;
+
+            tile_counts.at(t) = count;
+            tile_done.at(t)   = done;
+        }
+        else
+            return false;
+
+        if (ifs.fail())
+            return false;
+    }
+
+    return n_tiles > 0;
+}
+
+PIP_INLINE
+bool TilingManifest::write (const std::string &filename) const
+{
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream ofs (tmp);
+
+        if (!ofs.is_open())
+        {
+            std::cerr << "Error writing manifest: " << tmp << std::endl;
+            return false;
+        }
+
+        ofs << "las_path "      << las_path      << "\n"
+            << "las_size "      << las_size      << "\n"
+            << "n_points "      << n_points      << "\n"
+            << "n_regions "     << n_regions     << "\n"
+            << "n_vertices "    << n_vertices    << "\n"
+            << "memory_budget " << memory_budget << "\n"
+            << "policy "        << policy        << "\n"
+            << "halo "          << halo          << "\n"
+            << "nearest "       << nearest       << "\n"
+            << "prism "         << prism         << "\n";
+
+        if (!filter.empty())
+            ofs << "filter "        << filter        << "\n";
+
+        ofs << "tiles "         << nx << " " << ny << "\n"
+            << "binned "        << binned        << "\n"
+            << "unassigned "    << unassigned_bytes << "\n";
+
+        for (size_t t=0; t < tile_counts.size(); t++)
+            ofs << "tile " << t << " " << tile_counts.at(t) << " " << tile_done.at(t) << "\n";
+
+        ofs.flush();
+
+        if (ofs.fail())
+        {
+            std::cerr << "Error writing manifest: " << tmp << std::endl;
+            return false;
+        }
+    }
+
+    fs::rename(tmp, filename);
+    return true;
+}
+
+PIP_INLINE
+bool TilingManifest::same_run (const TilingManifest &m) const
+{
+    return las_path == m.las_path && las_size == m.las_size && n_points == m.n_points &&
+           n_regions == m.n_regions && n_vertices == m.n_vertices &&
+           memory_budget == m.memory_budget && policy == m.policy && halo == m.halo && nearest == m.nearest && prism == m.prism && filter == m.filter && nx == m.nx && ny == m.ny;
+}
+
+PIP_INLINE
+size_t tile_point_bytes (const liblas::Header &header)
+{
+    // point object and record, xy arrays, classification and regrouping arrays
+    // (point indices are 32-bit offsets within their chunk, see PointIds)
+    return sizeof(liblas::Point) + header.GetDataRecordLength() +
+           2 * sizeof(double) + 4 * sizeof(uint) + sizeof(uint64_t);
+}
+
+// Converts a file of raw point records (with the layout of header) to a LAS file
+PIP_INLINE
+bool write_LAS_records (const std::string &records_path, const liblas::Header &header, const std::string &filename)
+{
+    const size_t record_size = header.GetDataRecordLength();
+
+    std::vector<uint8_t> data (record_size);
+    liblas::Point p (&header);
+
+    LASStats stats;
+    {
+        std::ifstream ifs (records_path, std::ios::in | std::ios::binary);
+
+        while (ifs.read(reinterpret_cast<char*>(data.data()), record_size))
+        {
+            p.SetData(data);
+            stats.add(p);
+        }
+    }
+
+    std::cout << "Writing LAS file: " << filename << " (" << stats.count << " points)" << std::endl;
+
+    std::ofstream outFile (filename, std::ios::out | std::ios::binary);
+
+    if (!outFile.is_open())
+    {
+        std::cerr << "Error opening output LAS file: " << filename << std::endl;
+        return false;
+    }
+
+    liblas::Header h = header;
+    stats.apply(h);
+
+    {
+        liblas::Writer writer(outFile, h);
+        std::ifstream ifs (records_path, std::ios::in | std::ios::binary);
+
+        while (ifs.read(reinterpret_cast<char*>(data.data()), record_size))
+        {
+            p.SetData(data);
+            writer.WritePoint(p);
+        }
+    }
+
+    return true;
+}
+
+PIP_INLINE
+bool partition_LAS_tiled (const PolygonSet &polys, const std::string &las_path,
+                          const std::string &output_folder, const size_t memory_budget,
+                          const AssignmentOptions &opts, const LASFilter &filter,
+                          const bool verbose, const bool resume)
+{
+    const double reach = opts.reach();
+    const bool   write_unassigned = opts.nearest > 0.0;
+
+    std::ifstream ifs;
+    ifs.open(las_path.c_str(), std::ios::in | std::ios::binary);
+
+    if (!ifs.is_open())
+    {
+        std::cerr << "Error opening LAS file: " << las_path << std::endl;
+        return false;
+    }
+
+    liblas::Reader reader(ifs);
+    liblas::Header header = reader.GetHeader();
+
+    const size_t nPoints     = LAS_point_count(header, fs::file_size(las_path));
+    const size_t record_size = header.GetDataRecordLength();
+    const uint   nRegions    = polys.num_polygons();
+
+    LASPredicate pred;
+
+    if (!filter.compile(header, pred))
+        return false;
+
+    // tiles over the regions: points outside every region bbox are never assigned
+    BBox2 extent;
+    for (const BBox2 &b : polys.get_bboxes())
+        extent.add(b);
+
+    if (extent.empty())
+    {
+        std::cerr << "No regions to partition the point cloud." << std::endl;
+        return false;
+    }
+
+    // points near the tile borders go to more than one tile: leave some slack
+    size_t n_tiles = (2 * nPoints * tile_point_bytes(header)) / std::max(memory_budget, size_t(1)) + 1;
+
+    const size_t max_tiles = max_open_tiles();
+
+    if (n_tiles > max_tiles)
+    {
+        std::cerr << "Warning: the memory budget would need " << n_tiles << " tiles, using at most " << max_tiles << std::endl;
+        n_tiles = max_tiles;
+    }
+
+    // the grid may round the number of tiles up: shrink it until it fits the cap
+    TileGrid tiles;
+
+    for (size_t n = n_tiles; ; n--)
+    {
+        tiles.build(extent, n);
+
+        if (tiles.num_tiles() <= max_tiles || n == 1)
+            break;
+    }
+
+    n_tiles = tiles.num_tiles();
+
+    // home tile of each region, and area covered by each tile
+    std::vector<uint>  region_tile (nRegions, UINT_MAX);
+    std::vector<BBox2> tile_boxes (n_tiles);
+
+    for (uint pid=0; pid < nRegions; pid++)
+    {
+        const BBox2 &b = polys.bbox(pid);
+
+        if (b.empty()) continue;
+
+        region_tile.at(pid) = tiles.tile_of(0.5 * (b.xmin + b.xmax), 0.5 * (b.ymin + b.ymax));
+
+        // the points of a region lie in its bbox, grown by the halo or fallback distance
+        tile_boxes.at(region_tile.at(pid)).add(b.xmin - reach, b.ymin - reach);
+        tile_boxes.at(region_tile.at(pid)).add(b.xmax + reach, b.ymax + reach);
+    }
+
+    RegionGrid tile_index;
+    tile_index.build(tile_boxes);
+
+    std::cout << "Tiling: " << nPoints << " points, " << tiles.num_tiles_x() << " x " << tiles.num_tiles_y()
+              << " tiles, memory budget " << memory_budget / (1024 * 1024) << " MB" << std::endl;
+
+    fs::path tiles_folder = fs::path(output_folder) / ".tiles";
+    std::string manifest_path = (tiles_folder / "manifest.txt").string();
+
+    auto tile_path = [&](const size_t t) { return (tiles_folder / ("tile" + std::to_string(t) + ".bin")).string(); };
+
+    std::string unassigned_path = (tiles_folder / "unassigned.bin").string();
+
+    // first tile covering (x,y): the one writing the point if it is left unassigned
+    auto first_tile = [&](const double x, const double y)
+    {
+        for (uint t : tile_index.candidates(x, y))
+            if (tile_boxes.at(t).contains(x, y))
+                return t;
+
+        return UINT_MAX;
+    };
+
+    TilingManifest manifest;
+    manifest.las_path      = fs::absolute(las_path).string();
+    manifest.las_size      = fs::file_size(las_path);
+    manifest.n_points      = nPoints;
+    manifest.n_regions     = nRegions;
+    manifest.n_vertices    = polys.num_vertices();
+    manifest.memory_budget = memory_budget;
+    manifest.policy        = opts.policy;
+    manifest.halo          = opts.halo;
+    manifest.nearest       = opts.nearest;
+    manifest.filter        = filter.expression;
+    manifest.prism         = polys.has_z_bounds();
+    manifest.nx            = tiles.num_tiles_x();
+    manifest.ny            = tiles.num_tiles_y();
+    manifest.tile_counts.assign(n_tiles, 0);
+    manifest.tile_done.assign(n_tiles, false);
+
+    if (resume)
+    {
+        TilingManifest previous;
+
+        if (!previous.read(manifest_path))
+            std::cout << "No checkpoint found, starting from scratch" << std::endl;
+        else if (!previous.same_run(manifest))
+            std::cout << "The checkpoint refers to a different input or parameters, starting from scratch" << std::endl;
+        else if (!previous.binned)
+            std::cout << "The checkpoint precedes the end of the tiling pass, starting from scratch" << std::endl;
+        else
+        {
+            manifest = previous;
+
+            size_t n_done = std::count(manifest.tile_done.begin(), manifest.tile_done.end(), true);
+            std::cout << "Resuming from checkpoint: " << n_done << " / " << n_tiles << " tiles done" << std::endl;
+        }
+    }
+
+    if (!manifest.binned)
+    {
+        fs::remove_all(tiles_folder);
+        fs::create_directories(tiles_folder);
+    }
+    else if (write_unassigned)
+    {
+        // drop the records appended after the last checkpoint
+        fs::resize_file(unassigned_path, manifest.unassigned_bytes);
+    }
+
+    std::ofstream unassigned_file;
+
+    if (write_unassigned)
+    {
+        // appending to the records of the checkpoint, if any
+        if (manifest.binned)
+            unassigned_file.open(unassigned_path, std::ios::in | std::ios::out | std::ios::binary);
+        else
+            unassigned_file.open(unassigned_path, std::ios::out | std::ios::binary);
+
+        unassigned_file.seekp(0, std::ios::end);
+
+        if (!unassigned_file.is_open())
+        {
+            std::cerr << "Error opening tile file: " << unassigned_path << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<size_t> &tile_counts = manifest.tile_counts;
+
+    ///
+    // Pass 1: bin the points into the tiles
+
+    if (!manifest.binned)
+    {
+        std::vector<std::ofstream> tile_files (n_tiles);
+
+        for (size_t t=0; t < n_tiles; t++)
+        {
+            if (tile_boxes.at(t).empty()) continue;
+
+            tile_files.at(t).open(tile_path(t), std::ios::out | std::ios::binary);
+
+            if (!tile_files.at(t).is_open())
+            {
+                std::cerr << "Error opening tile file: " << tile_path(t) << std::endl;
+                return false;
+            }
+        }
+
+        size_t nRead = 0, nSelected = 0;
+
+        while (reader.ReadNextPoint())
+        {
+            const liblas::Point &p = reader.GetPoint();
+            const std::vector<uint8_t> &data = p.GetData();
+
+            if (verbose && (++nRead % (1 << 24)) == 0)
+                std::cout << "Binned " << nRead << " points / " << nPoints << " total points..." << std::endl;
+
+            if (!pred.accept(p))
+                continue;
+
+            nSelected++;
+
+            bool binned = false;
+
+            for (uint t : tile_index.candidates(p.GetX(), p.GetY()))
+            {
+                if (!tile_boxes.at(t).contains(p.GetX(), p.GetY()))
+                    continue;
+
+                tile_files.at(t).write(reinterpret_cast<const char*>(data.data()), record_size);
+                tile_counts.at(t)++;
+                binned = true;
+            }
+
+            // too far from every region
+            if (!binned && write_unassigned)
+                unassigned_file.write(reinterpret_cast<const char*>(data.data()), record_size);
+        }
+
+        if (pred.active)
+            std::cout << "Filter " << filter.expression << ": " << nSelected << " of " << nRead << " points selected" << std::endl;
+
+        for (size_t t=0; t < n_tiles; t++)
+        {
+            if (tile_files.at(t).is_open())
+                tile_files.at(t).close();
+
+            if (tile_files.at(t).fail())
+            {
+                std::cerr << "Error writing tile file: " << tile_path(t) << std::endl;
+                return false;
+            }
+        }
+
+        manifest.binned = true;
+
+        if (write_unassigned && !unassigned_file.flush())
+        {
+            std::cerr << "Error writing tile file: " << unassigned_path << std::endl;
+            return false;
+        }
+
+        manifest.unassigned_bytes = write_unassigned ? uintmax_t(unassigned_file.tellp()) : 0;
+
+        if (!manifest.write(manifest_path))
+            return false;
+    }
+
+    ifs.close();
+
+    ///
+    // Pass 2: classify each tile and write its regions
+
+    std::vector<std::vector<uint>> tile_regions (n_tiles);
+    for (uint pid=0; pid < nRegions; pid++)
+    {
+        if (region_tile.at(pid) == UINT_MAX)
+            std::cout << "Region " << pid << " has no points." << std::endl;
+        else
+            tile_regions.at(region_tile.at(pid)).push_back(pid);
+    }
+
+    std::vector<liblas::Point> points;
+    std::vector<double> xs, ys, zs;   // zs only for prisms
+    std::vector<uint> point2region;
+    std::vector<uint> region_local (nRegions, UINT_MAX);
+
+    SegmentGrid  edges;
+    PointRegions point_regions;
+
+    if (opts.uses_edges())
+        edges.build(polys);
+
+    for (size_t t=0; t < n_tiles; t++)
+    {
+        if (tile_regions.at(t).empty() || manifest.tile_done.at(t))
+            continue;
+
+        if (verbose)
+            std::cout << "Tile " << t+1 << " / " << n_tiles << ": " << tile_counts.at(t) << " points, "
+                      << tile_regions.at(t).size() << " regions" << std::endl;
+
+        if (tile_counts.at(t) * tile_point_bytes(header) > memory_budget)
+            std::cerr << "Warning: tile " << t << " exceeds the memory budget (" << tile_counts.at(t) << " points)" << std::endl;
+
+        points.clear();
+        xs.clear();
+        ys.clear();
+        zs.clear();
+
+        points.reserve(tile_counts.at(t));
+        xs.reserve(tile_counts.at(t));
+        ys.reserve(tile_counts.at(t));
+
+        {
+            std::ifstream tile_file (tile_path(t), std::ios::in | std::ios::binary);
+            std::vector<uint8_t> data (record_size);
+
+            liblas::Point p (&header);
+
+            for (size_t i=0; i < tile_counts.at(t); i++)
+            {
+                if (!tile_file.read(reinterpret_cast<char*>(data.data()), record_size))
+                {
+                    std::cerr << "Error reading tile file: " << tile_path(t) << std::endl;
+                    return false;
+                }
+
+                p.SetData(data);
+
+                points.push_back(p);
+                xs.push_back(p.GetX());
+                ys.push_back(p.GetY());
+
+                if (polys.has_z_bounds())
+                    zs.push_back(p.GetZ());
+            }
+        }
+
+        point2region.assign(points.size(), UINT_MAX);
+        assign_regions(polys, opts, edges, xs.data(), ys.data(), zs.empty() ? nullptr : zs.data(), xs.size(),
+                       point2region.data(), point_regions, verbose);
+
+        // keep the points of the regions of this tile: the others are written by their own tile
+        for (uint i=0; i < tile_regions.at(t).size(); i++)
+            region_local.at(tile_regions.at(t).at(i)) = i;
+
+        RegionPoints region2point;
+
+        if (opts.multi())
+        {
+            build_region_points(point_regions.num_points(), tile_regions.at(t).size(), [&] (const size_t j, const auto &visit)
+            {
+                for (uint pid : point_regions.of(j))
+                    if (region_tile[pid] == t) visit(region_local[pid]);
+            }, region2point);
+        }
+        else
+        {
+            build_region_points(point2region.size(), tile_regions.at(t).size(), [&] (const size_t j, const auto &visit)
+            {
+                uint pid = point2region[j];
+                if (pid < UINT_MAX && region_tile[pid] == t) visit(region_local[pid]);
+            }, region2point);
+        }
+
+        for (uint i=0; i < tile_regions.at(t).size(); i++)
+        {
+            uint pid = tile_regions.at(t).at(i);
+
+            if (region2point.of(i).empty())
+                std::cout << "Region " << pid << " has no points." << std::endl;
+            else if (!write_LAS(region_LAS_path(output_folder, pid), header, points, region2point.of(i)))
+                return false;
+        }
+
+        if (write_unassigned)
+        {
+            RegionPoints unassigned = opts.multi() ? unassigned_points(point_regions) : unassigned_points(point2region);
+
+            unassigned.of(0).for_each([&] (const uint64_t j)
+            {
+                if (first_tile(xs.at(j), ys.at(j)) == t)
+                    unassigned_file.write(reinterpret_cast<const char*>(points.at(j).GetData().data()), record_size);
+            });
+
+            if (!unassigned_file.flush())
+            {
+                std::cerr << "Error writing tile file: " << unassigned_path << std::endl;
+                return false;
+            }
+
+            manifest.unassigned_bytes = unassigned_file.tellp();
+        }
+
+        // checkpoint: the regions of this tile are complete
+        manifest.tile_done.at(t) = true;
+
+        if (!manifest.write(manifest_path))
+            return false;
+
+        fs::remove(tile_path(t));
+    }
+
+    if (write_unassigned)
+    {
+        unassigned_file.close();
+
+        if (!write_LAS_records(unassigned_path, header, output_folder + "/unassigned.las"))
+            return false;
+    }
+
+    fs::remove_all(tiles_folder);
+
+    return true;
+}
+
+}
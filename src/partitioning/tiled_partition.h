@@ -0,0 +1,111 @@
+/**
+ *
+ * Daniela Cabiddu
+ * daniela.cabiddu@cnr.it
+ *
+**/
+
+#ifndef TILED_PARTITION_H
+#define TILED_PARTITION_H
+
+#include "../utils/pip_inline.h"
+#include "polygon_set.h"
+#include "classifier.h"
+#include "../io/filter_LAS.h"
+
+#include <liblas/liblas.hpp>
+
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Coarse uniform grid of tiles over an extent
+class TileGrid
+{
+private:
+
+    BBox2 extent;
+    double tile_w = 1.0;
+    double tile_h = 1.0;
+    uint nx = 1;
+    uint ny = 1;
+
+public:
+
+    // about n_tiles square-ish tiles (at least 1, at most n_tiles along each side)
+    void build (const BBox2 &e, const size_t n_tiles);
+
+    uint num_tiles_x () const { return nx; }
+    uint num_tiles_y () const { return ny; }
+    size_t num_tiles () const { return size_t(nx) * ny; }
+
+    // tile containing (x,y), clamped to the grid
+    uint tile_of (const double x, const double y) const;
+};
+
+// Checkpoint of a tiled run, stored in <output>/.tiles/manifest.txt: the run
+// parameters (to detect a changed input), the number of points binned into each
+// tile, and the tiles whose regions have been written
+class TilingManifest
+{
+public:
+
+    std::string las_path;
+    uintmax_t   las_size     = 0;
+    size_t      n_points     = 0;
+    size_t      n_regions    = 0;
+    size_t      n_vertices   = 0;
+    size_t      memory_budget = 0;
+    int         policy = FIRST_REGION;
+    double      halo = 0.0;
+    double      nearest = 0.0;
+    bool        prism = false;         // regions with Z bounds
+    std::string filter;                // expression of the point filter, if any
+    uint        nx = 0, ny = 0;
+
+    bool binned = false;               // pass 1 completed
+    std::vector<size_t> tile_counts;
+    std::vector<bool>   tile_done;
+    uintmax_t unassigned_bytes = 0;    // records of unassigned points written so far
+
+    bool read (const std::string &filename);
+
+    // written to a temporary file, then renamed: a crash leaves the previous checkpoint
+    bool write (const std::string &filename) const;
+
+    // same input, regions and tiling
+    bool same_run (const TilingManifest &m) const;
+};
+
+// Memory taken by one point while its tile is being processed
+size_t tile_point_bytes (const liblas::Header &header);
+
+// Two-level, out-of-core partitioning of a LAS file, for clouds that do not fit in memory.
+// Each region is assigned to the tile containing the center of its bbox, and each
+// tile covers the union of the bboxes of its regions.
+// Pass 1 streams the cloud and appends each point to the tiles covering it, as raw
+// point records in a temporary folder. Pass 2 processes one tile at a time: it loads
+// its points, classifies them (the grid only proposes the regions overlapping the tile)
+// and writes the regions of the tile. Output is the same as the in-memory pipeline.
+// The number of tiles is chosen so that a tile takes about memory_budget bytes.
+// Points are assigned to regions according to opts (overlap policy, halo, nearest-region
+// fallback). With the fallback enabled, the points left without a region are written to
+// <output>/unassigned.las (in tile order). Only the points selected by filter are
+// binned, and thus partitioned; the filter is tested in pass 1, on the raw records.
+// The manifest is updated after pass 1 and after each tile; with resume set, a run
+// with the same input and parameters restarts from the last checkpoint.
+bool partition_LAS_tiled (const PolygonSet &polys, const std::string &las_path,
+                          const std::string &output_folder, const size_t memory_budget,
+                          const AssignmentOptions &opts = AssignmentOptions(),
+                          const LASFilter &filter = LASFilter(),
+                          const bool verbose = false, const bool resume = false);
+
+}
+
+#ifndef static_lib
+#include "tiled_partition.cpp"
+#endif
+
+#endif // TILED_PARTITION_H
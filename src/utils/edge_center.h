@@ -1,6 +1,7 @@
 #ifndef EDGE_CENTER_H
 #define EDGE_CENTER_H
 
+#include "pip_inline.h"
 #include <cinolib/geometry/vec_mat.h>
 
 namespace URBAN3D
@@ -0,0 +1,13 @@
+#ifndef PIP_INLINE_H
+#define PIP_INLINE_H
+
+// Function definitions live in .cpp files. By default each header includes its .cpp
+// and the definitions are inline (header-only use); when static_lib is defined the
+// .cpp files are compiled once, into the pip_partition library.
+#ifdef static_lib
+#define PIP_INLINE
+#else
+#define PIP_INLINE inline
+#endif
+
+#endif // PIP_INLINE_H
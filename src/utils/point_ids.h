@@ -0,0 +1,85 @@
+#ifndef POINT_IDS_H
+#define POINT_IDS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/types.h>
+
+// Point indices are 64-bit, but lists of them are stored as 32-bit offsets relative
+// to the 64-bit base of their chunk: point j is offset (j % POINT_CHUNK) of chunk
+// (j / POINT_CHUNK). The chunk size can be lowered at build time (e.g. for testing).
+#ifndef PIP_POINT_CHUNK_BITS
+#define PIP_POINT_CHUNK_BITS 32
+#endif
+
+static_assert(PIP_POINT_CHUNK_BITS >= 1 && PIP_POINT_CHUNK_BITS <= 32, "point offsets must fit 32 bits");
+
+namespace URBAN3D
+{
+
+const uint64_t POINT_CHUNK = uint64_t(1) << PIP_POINT_CHUNK_BITS;
+
+inline size_t num_point_chunks (const uint64_t n_points)
+{
+    return std::max(uint64_t(1), (n_points + POINT_CHUNK - 1) / POINT_CHUNK);
+}
+
+inline size_t point_chunk (const uint64_t j) { return j >> PIP_POINT_CHUNK_BITS; }
+inline uint   point_offset (const uint64_t j) { return uint(j & (POINT_CHUNK - 1)); }
+
+// Non-owning view over a list of point indices, in chunked form: offsets has
+// n_chunks+1 entries and ids[offsets[c] .. offsets[c+1]) are the offsets of the
+// points of chunk c. A plain list of offsets is a single chunk; with no ids,
+// the view holds all the points 0 .. n-1.
+class PointIds
+{
+private:
+
+    const uint     *ids     = nullptr;
+    const uint64_t *offsets = nullptr;
+    size_t          n_chunks = 1;
+    uint64_t        single[2] = {0, 0};
+
+    const uint64_t * chunk_offsets () const { return offsets ? offsets : single; }
+
+public:
+
+    PointIds () {}
+    PointIds (const uint *ids, const uint64_t *offsets, const size_t n_chunks) : ids(ids), offsets(offsets), n_chunks(n_chunks) {}
+    PointIds (const uint *ids, const size_t n) : ids(ids), single{0, n} {}
+    PointIds (const std::vector<uint> &ids) : PointIds(ids.data(), ids.size()) {}
+
+    static PointIds all (const uint64_t n) { return PointIds(nullptr, n); }
+
+    uint64_t size () const { return chunk_offsets()[n_chunks] - chunk_offsets()[0]; }
+    bool empty () const { return size() == 0; }
+
+    // f(j) for each point index j, in order
+    template<class F>
+    void for_each (const F &f) const
+    {
+        const uint64_t *off = chunk_offsets();
+
+        if (!ids)
+        {
+            for (uint64_t j = off[0]; j < off[1]; j++)
+                f(j);
+            return;
+        }
+
+        for (size_t c = 0; c < n_chunks; c++)
+        {
+            const uint64_t base = c * POINT_CHUNK;
+
+            for (uint64_t k = off[c]; k < off[c+1]; k++)
+                f(base + ids[k]);
+        }
+    }
+};
+
+}
+
+#endif // POINT_IDS_H
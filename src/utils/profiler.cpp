@@ -0,0 +1,179 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace URBAN3D
+{
+
+PIP_INLINE
+Profiler & Profiler::instance ()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+PIP_INLINE
+void Profiler::add_phase (const std::string &name, const double seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (uint i=0; i < phase_names.size(); i++)
+        if (phase_names.at(i) == name)
+        {
+            phase_seconds.at(i) += seconds;
+            phase_calls.at(i)++;
+            return;
+        }
+
+    phase_names.push_back(name);
+    phase_seconds.push_back(seconds);
+    phase_calls.push_back(1);
+}
+
+PIP_INLINE
+ProfileCounters * Profiler::register_thread ()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    threads.push_back(std::make_unique<ProfileCounters>());
+    return threads.back().get();
+}
+
+PIP_INLINE
+ProfileCounters Profiler::totals ()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ProfileCounters sum;
+
+    for (const auto &t : threads)
+        for (uint c=0; c < N_PROFILE_COUNTERS; c++)
+            sum.values[c] += t->values[c];
+
+    return sum;
+}
+
+PIP_INLINE
+void Profiler::add_quick_accepts (const uint64_t accepted, const uint64_t tested)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    quick_accepts  += accepted;
+    crossing_tests += tested;
+}
+
+PIP_INLINE
+double Profiler::quick_accept_ratio ()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint64_t n = quick_accepts + crossing_tests;
+    return n > 0 ? double(quick_accepts) / n : 0.0;
+}
+
+PIP_INLINE
+void Profiler::print_summary (std::ostream &out)
+{
+#ifdef PIP_PROFILE_COUNTERS
+    ProfileCounters sum = totals();
+#endif
+    double ratio = quick_accept_ratio();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    double total = 0.0;
+    for (double s : phase_seconds)
+        total += s;
+
+    out << "---- Profile ----" << std::endl;
+
+    for (uint i=0; i < phase_names.size(); i++)
+    {
+        out << std::left << std::setw(20) << phase_names.at(i)
+            << std::right << std::fixed << std::setprecision(3) << std::setw(12) << phase_seconds.at(i) << " s"
+            << std::setw(8) << std::setprecision(1) << (total > 0.0 ? 100.0 * phase_seconds.at(i) / total : 0.0) << " %"
+            << std::endl;
+    }
+
+#ifdef PIP_PROFILE_COUNTERS
+    for (uint c=0; c < N_PROFILE_COUNTERS; c++)
+        out << std::left << std::setw(20) << profile_counter_name(ProfileCounter(c))
+            << std::right << std::setw(16) << sum.values[c] << std::endl;
+#endif
+
+    if (quick_accepts + crossing_tests > 0)
+        out << std::left << std::setw(20) << "quick_accept_ratio"
+            << std::right << std::setw(16) << std::setprecision(3) << ratio << std::endl;
+
+    out << "-----------------" << std::endl;
+}
+
+PIP_INLINE
+bool Profiler::write_json (const std::string &filename)
+{
+#ifdef PIP_PROFILE_COUNTERS
+    ProfileCounters sum = totals();
+#endif
+    double ratio = quick_accept_ratio();
+
+    std::ofstream out(filename);
+
+    if (!out.is_open())
+    {
+        std::cerr << "Error opening profile file: " << filename << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    out << "{" << std::endl;
+    out << "  \"phases\": [" << std::endl;
+
+    for (uint i=0; i < phase_names.size(); i++)
+    {
+        out << "    { \"name\": \"" << phase_names.at(i) << "\", \"seconds\": " << std::setprecision(9) << phase_seconds.at(i)
+            << ", \"calls\": " << phase_calls.at(i) << " }" << (i+1 < phase_names.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]," << std::endl;
+    out << "  \"counters\": {" << std::endl;
+
+#ifdef PIP_PROFILE_COUNTERS
+    for (uint c=0; c < N_PROFILE_COUNTERS; c++)
+        out << "    \"" << profile_counter_name(ProfileCounter(c)) << "\": " << sum.values[c] << "," << std::endl;
+#endif
+    out << "    \"quick_accept_ratio\": " << std::setprecision(6) << ratio << std::endl;
+
+    out << "  }" << std::endl;
+    out << "}" << std::endl;
+
+    return true;
+}
+
+PIP_INLINE
+PhaseTimer::~PhaseTimer ()
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    Profiler::instance().add_phase(name, elapsed.count());
+}
+
+PIP_INLINE
+const char * profile_counter_name (const ProfileCounter c)
+{
+    switch (c)
+    {
+    case PNPOLY_CALLS:       return "pnpoly_calls";
+    case EDGES_TESTED:       return "edges_tested";
+    case BBOX_REJECTIONS:    return "bbox_rejections";
+    case INDEX_CANDIDATES:   return "index_candidates";
+    case WALK_STEPS:         return "walk_steps";
+    case QUICK_ACCEPTS:      return "quick_accepts";
+    case CROSSING_TESTS:     return "crossing_tests";
+    case N_PROFILE_COUNTERS: break;
+    }
+    return "";
+}
+
+}
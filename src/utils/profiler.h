@@ -0,0 +1,109 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "pip_inline.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace URBAN3D
+{
+
+// Hot-path counters, collected per thread when compiled with PIP_PROFILE_COUNTERS
+enum ProfileCounter
+{
+    PNPOLY_CALLS,
+    EDGES_TESTED,
+    BBOX_REJECTIONS,
+    INDEX_CANDIDATES,
+    WALK_STEPS,
+    QUICK_ACCEPTS,     // points accepted by an inner box of a polygon
+    CROSSING_TESTS,    // points that went through the crossing test of a polygon
+    N_PROFILE_COUNTERS
+};
+
+// one cache line per thread, so that threads never share the counters they bump
+struct alignas(64) ProfileCounters
+{
+    uint64_t values[N_PROFILE_COUNTERS] = {};
+};
+
+// Run-wide collection of phase timings and per-thread counters
+class Profiler
+{
+private:
+
+    std::vector<std::string> phase_names;  // in order of first appearance
+    std::vector<double>      phase_seconds;
+    std::vector<uint64_t>    phase_calls;
+
+    std::vector<std::unique_ptr<ProfileCounters>> threads;
+
+    // points accepted by an inner box, and tested for crossings, by the polygon
+    // classifiers: counted in every build, for the quick-accept ratio
+    uint64_t quick_accepts  = 0;
+    uint64_t crossing_tests = 0;
+
+    std::mutex mutex;
+
+public:
+
+    static Profiler & instance ();
+
+    void add_phase (const std::string &name, const double seconds);
+
+    // slot for the calling thread (see thread_counters())
+    ProfileCounters * register_thread ();
+
+    ProfileCounters totals ();
+
+    // called once per thread and batch, with the thread's own tallies
+    void add_quick_accepts (const uint64_t accepted, const uint64_t tested);
+
+    // share of the points within a polygon bbox that an inner box accepted
+    double quick_accept_ratio ();
+
+    void print_summary (std::ostream &out);
+    bool write_json (const std::string &filename);
+};
+
+// Times the enclosing scope and records it as a phase of the run
+class PhaseTimer
+{
+private:
+
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+
+public:
+
+    PhaseTimer (const std::string &phase) : name(phase), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer ();
+};
+
+const char * profile_counter_name (const ProfileCounter c);
+
+inline
+ProfileCounters & thread_counters ()
+{
+    thread_local ProfileCounters *counters = Profiler::instance().register_thread();
+    return *counters;
+}
+
+}
+
+#ifdef PIP_PROFILE_COUNTERS
+#define PIP_COUNT(counter, n) (URBAN3D::thread_counters().values[URBAN3D::counter] += (n))
+#else
+#define PIP_COUNT(counter, n) ((void) 0)
+#endif
+
+#ifndef static_lib
+#include "profiler.cpp"
+#endif
+
+#endif // PROFILER_H